@@ -0,0 +1,253 @@
+//----------------------------------------------------------------------
+// FILE:   BatchPipeline.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Pipelined batch processing of multiple land/sea mask files.
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <thread>
+using namespace std;
+
+#include "ncFile.h"
+using namespace netCDF;
+
+#include "BatchPipeline.hh"
+#include "UMFile.hh"
+#include "SessionFile.hh"
+#include "Regrid.hh"
+
+
+// Number of worker threads to use: default to one per core.
+
+static unsigned int workerCount(const BatchPipeline::Options &opts)
+{
+  unsigned int n = opts.nworkers;
+  if (n == 0) n = thread::hardware_concurrency();
+  return n == 0 ? 1 : n;
+}
+
+BatchPipeline::BatchPipeline(const Options &o) :
+  opts(o),
+  decoded(workerCount(o)),
+  computed(workerCount(o)),
+  active(0), failures(0)
+{
+  opts.nworkers = workerCount(o);
+}
+
+
+// Process a list of mask files.
+
+int BatchPipeline::run(const vector<string> &files)
+{
+  if (files.size() > 1 &&
+      ((opts.islpattern != "" && opts.islpattern.find("%s") == string::npos) ||
+       (opts.outpattern != "" && opts.outpattern.find("%s") == string::npos) ||
+       (opts.sesspattern != "" &&
+        opts.sesspattern.find("%s") == string::npos)))
+    throw runtime_error("Output file names must contain %s "
+                        "when processing multiple mask files");
+  if (opts.allgrids &&
+      ((opts.islpattern != "" && opts.islpattern.find("%g") == string::npos) ||
+       (opts.outpattern != "" && opts.outpattern.find("%g") == string::npos) ||
+       (opts.sesspattern != "" &&
+        opts.sesspattern.find("%g") == string::npos)))
+    throw runtime_error("Output file names must contain %g "
+                        "when generating masks for all grids");
+
+  // Start reader and worker stages, then run the writer stage here.
+  failures = 0;
+  active = opts.nworkers;
+  thread rd(&BatchPipeline::reader, this, files);
+  vector<thread> ws;
+  for (unsigned int i = 0; i < opts.nworkers; ++i)
+    ws.push_back(thread(&BatchPipeline::worker, this));
+  writer();
+  rd.join();
+  for (vector<thread>::iterator it = ws.begin(); it != ws.end(); ++it)
+    it->join();
+  return failures;
+}
+
+
+// Reader stage: open and decode mask files.
+
+void BatchPipeline::reader(const vector<string> &files)
+{
+  for (vector<string>::const_iterator it = files.begin();
+       it != files.end(); ++it) {
+    JobPtr job(new Job);
+    job->maskfile = *it;
+    if (opts.allgrids) {
+      readSource(job);
+      continue;
+    }
+    try {
+      // Session files and masks saved with derived data are loaded
+      // here, ready for the writer: they need no recalculation
+      // (unless the derived data turns out to be stale).
+      if (SessionFile::isSessionFile(*it)) {
+        job->model.reset(new IslaModel(IslaModel::HadCM3L, opts.threshold));
+        job->model->loadSession(*it, job->comp);
+      } else if (UMFile::isUMFile(*it))
+        job->mask.reset(new GridData<bool>(IslaModel::readUMMask(*it)));
+      else {
+        lock_guard<mutex> lock(nclock);
+        NcFile nc(*it, NcFile::read);
+        string var = opts.maskvar != "" ?
+          opts.maskvar : IslaModel::findMaskVar(nc);
+        if (var == "mask" && IslaModel::hasDerived(nc)) {
+          job->model.reset(new IslaModel(IslaModel::HadCM3L,
+                                         opts.threshold));
+          job->model->loadMask(*it, var);
+        } else {
+          GridPtr gr(new Grid(nc));
+          job->mask.reset(new GridData<bool>(gr, nc, var));
+        }
+      }
+    } catch (std::exception &e) {
+      job->error = e.what();
+    }
+    decoded.push(job);
+  }
+  decoded.close();
+}
+
+
+// Read a source field for all-grids mode and queue a job for each
+// standard grid.  Masks are read as land fractions of 0 or 1.
+
+void BatchPipeline::readSource(JobPtr job)
+{
+  try {
+    boost::shared_ptr< GridData<double> > src;
+    if (SessionFile::isSessionFile(job->maskfile))
+      throw runtime_error("Session files can't be regridded");
+    else if (UMFile::isUMFile(job->maskfile)) {
+      GridData<bool> mask = IslaModel::readUMMask(job->maskfile);
+      src.reset(new GridData<double>(mask.grid(), 0.0));
+      mask.process(*src, GridData<double>::Convert<bool>());
+    } else {
+      lock_guard<mutex> lock(nclock);
+      NcFile nc(job->maskfile, NcFile::read);
+      string var = opts.maskvar != "" ?
+        opts.maskvar : IslaModel::findMaskVar(nc);
+      GridPtr gr(new Grid(nc));
+      src.reset(new GridData<double>(gr, nc, var));
+    }
+    job->source = src;
+  } catch (std::exception &e) {
+    job->error = e.what();
+    decoded.push(job);
+    return;
+  }
+  const IslaModel::GridType grids[] =
+    { IslaModel::HadCM3L, IslaModel::HadCM3, IslaModel::HadGEM2 };
+  for (int g = 0; g < 3; ++g) {
+    JobPtr gjob(new Job(*job));
+    gjob->gridtype = grids[g];
+    gjob->gridname = IslaModel::gridName(grids[g]);
+    decoded.push(gjob);
+  }
+}
+
+
+// Worker stage: landmass, ISMASK and island calculations.
+
+void BatchPipeline::worker(void)
+{
+  JobPtr job;
+  while (decoded.pop(job)) {
+    if (job->error == "" && !job->model) {
+      try {
+        if (job->source) {
+          // Regrid on this worker only: the workers already run in
+          // parallel.
+          GridData<bool> mask(IslaModel::makeGrid(job->gridtype), false);
+          regrid(*job->source, mask, Majority(opts.landfrac), 1);
+          job->model.reset(new IslaModel(job->gridtype, opts.threshold));
+          job->model->loadMask(mask);
+        } else {
+          job->model.reset(new IslaModel(IslaModel::HadCM3L,
+                                         opts.threshold));
+          job->model->loadMask(*job->mask);
+        }
+      } catch (std::exception &e) {
+        job->error = e.what();
+        job->model.reset();
+      }
+    }
+    job->mask.reset();
+    job->source.reset();
+    computed.push(job);
+  }
+
+  // The last worker to finish shuts down the writer.
+  lock_guard<mutex> lock(wlock);
+  if (--active == 0) computed.close();
+}
+
+
+// Writer stage: island files and derived fields.
+
+void BatchPipeline::writer(void)
+{
+  JobPtr job;
+  while (computed.pop(job)) {
+    try {
+      if (job->error != "") throw runtime_error(job->error);
+      IslaModel &model = *job->model;
+      if (opts.islpattern != "")
+        model.saveIslands(outputName(opts.islpattern, job->maskfile,
+                                     job->gridname),
+                          opts.binary ? IslandWriter::BINARY :
+                          IslandWriter::ASCII);
+      if (opts.sesspattern != "")
+        model.saveSession(outputName(opts.sesspattern, job->maskfile,
+                                     job->gridname),
+                          job->comp);
+      if (opts.outpattern != "") {
+        lock_guard<mutex> lock(nclock);
+        model.saveMask(outputName(opts.outpattern, job->maskfile,
+                                  job->gridname), true,
+                       opts.compressed);
+      }
+      if (!opts.quiet)
+        cout << job->maskfile
+             << (job->gridname != "" ? " (" + job->gridname + ")" : "")
+             << ": " << model.grid()->nlon() << "x"
+             << model.grid()->nlat() << " grid, "
+             << model.landMassCount() << " landmasses, "
+             << model.islands().size() << " islands" << endl;
+    } catch (std::exception &e) {
+      cerr << job->maskfile
+           << (job->gridname != "" ? " (" + job->gridname + ")" : "")
+           << ": " << e.what() << endl;
+      if (!*job->failed) {
+        *job->failed = true;
+        ++failures;
+      }
+    }
+  }
+}
+
+
+// Make output file name from pattern.
+
+string BatchPipeline::outputName(string pattern, string maskfile,
+                                 string gridname)
+{
+  string stem = maskfile;
+  string::size_type slash = stem.rfind('/');
+  if (slash != string::npos) stem = stem.substr(slash + 1);
+  string::size_type dot = stem.rfind('.');
+  if (dot != string::npos && dot > 0) stem = stem.substr(0, dot);
+  string::size_type pos;
+  while ((pos = pattern.find("%s")) != string::npos)
+    pattern.replace(pos, 2, stem);
+  while ((pos = pattern.find("%g")) != string::npos)
+    pattern.replace(pos, 2, gridname);
+  return pattern;
+}
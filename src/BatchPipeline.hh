@@ -0,0 +1,103 @@
+//----------------------------------------------------------------------
+// FILE:   BatchPipeline.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Pipelined batch processing of multiple land/sea mask files.
+//
+// There are three stages connected by bounded queues: a reader
+// thread that opens and decodes NetCDF mask files, a pool of worker
+// threads that run the landmass, ISMASK and island calculations, and
+// a writer stage (run on the calling thread) that writes island and
+// derived field files.  Because all stages run concurrently, the
+// throughput is limited by the slowest stage rather than by the sum
+// of the stage times.
+//
+// In all-grids mode, each input is a high-resolution mask or land
+// fraction field that is read once and regridded to each of the
+// standard model grids, giving one job per grid.  The jobs for the
+// different grids share the source field and run concurrently on the
+// worker threads, and regridding weights are shared between all jobs
+// for the same source grid.
+//----------------------------------------------------------------------
+
+#ifndef _H_BATCHPIPELINE_
+#define _H_BATCHPIPELINE_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <boost/shared_ptr.hpp>
+
+#include "ncFile.h"
+#include "GridData.hh"
+#include "IslaModel.hh"
+#include "BoundedQueue.hh"
+
+class BatchPipeline {
+public:
+  struct Options {
+    Options() :
+      threshold(8.0E6), nworkers(0), binary(false), compressed(false),
+      allgrids(false), landfrac(0.5), quiet(false) { }
+    std::string maskvar;        // Mask variable (empty => guess).
+    std::string islpattern;     // Island file name pattern.
+    std::string outpattern;     // Derived field file name pattern.
+    std::string sesspattern;    // Session file name pattern.
+    double threshold;           // Island area threshold (km^2).
+    unsigned int nworkers;      // Worker threads (0 => one per core).
+    bool binary;                // Write binary island files?
+    bool compressed;            // Write compressed NetCDF-4 masks?
+    bool allgrids;              // Regrid to all standard grids?
+    double landfrac;            // Land fraction for land cells.
+    bool quiet;                 // Suppress per-file summaries?
+  };
+
+  BatchPipeline(const Options &opts);
+
+  // Process a list of mask files, returning the number of files that
+  // could not be processed (in all-grids mode, a file counts once
+  // however many of its grids fail).
+  int run(const std::vector<std::string> &files);
+
+  // Make an output file name from a pattern by replacing "%s" with
+  // the input file name stripped of its directory and extension, and
+  // "%g" with the grid name (all-grids mode).
+  static std::string outputName(std::string pattern, std::string maskfile,
+                                std::string gridname = "");
+
+private:
+  struct Job {
+    Job() : gridtype(IslaModel::HadCM3L), failed(new bool(false)) { }
+    std::string maskfile;
+    boost::shared_ptr< GridData<bool> > mask;
+
+    // All-grids mode: shared source field and target grid.
+    boost::shared_ptr< const GridData<double> > source;
+    IslaModel::GridType gridtype;
+    std::string gridname;
+
+    boost::shared_ptr<IslaModel> model;
+    std::vector<IslaModel::IslandInfo> comp;    // From session files.
+    std::string error;
+    boost::shared_ptr<bool> failed;     // Shared by all jobs for a file.
+  };
+  typedef boost::shared_ptr<Job> JobPtr;
+
+  void reader(const std::vector<std::string> &files);
+  void readSource(JobPtr job);
+  void worker(void);
+  void writer(void);
+
+  Options opts;
+  BoundedQueue<JobPtr> decoded;   // Reader => workers.
+  BoundedQueue<JobPtr> computed;  // Workers => writer.
+  std::mutex nclock;              // The NetCDF library isn't
+                                  // thread-safe, so all NetCDF access
+                                  // is serialised.
+  std::mutex wlock;
+  unsigned int active;            // Number of running workers.
+  int failures;
+};
+
+#endif
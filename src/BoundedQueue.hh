@@ -0,0 +1,62 @@
+//----------------------------------------------------------------------
+// FILE:   BoundedQueue.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Fixed capacity blocking queue used to connect batch pipeline
+// stages.  Producers block when the queue is full and consumers
+// block when it is empty, so no stage can run more than a queue
+// length ahead of the next.
+//----------------------------------------------------------------------
+
+#ifndef _H_BOUNDEDQUEUE_
+#define _H_BOUNDEDQUEUE_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+template<typename T> class BoundedQueue {
+public:
+  BoundedQueue(unsigned int capacity) : cap(capacity), closed(false) { }
+
+  // Add an item, waiting for space if the queue is full.  Returns
+  // false if the queue has been closed.
+  bool push(const T &item) {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (q.size() >= cap && !closed) notfull.wait(lock);
+    if (closed) return false;
+    q.push_back(item);
+    notempty.notify_one();
+    return true;
+  }
+
+  // Remove an item, waiting for one if the queue is empty.  Returns
+  // false once the queue is closed and drained.
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (q.empty() && !closed) notempty.wait(lock);
+    if (q.empty()) return false;
+    item = q.front();
+    q.pop_front();
+    notfull.notify_one();
+    return true;
+  }
+
+  // Signal that no more items will be added.
+  void close(void) {
+    std::lock_guard<std::mutex> lock(mtx);
+    closed = true;
+    notempty.notify_all();
+    notfull.notify_all();
+  }
+
+private:
+  unsigned int cap;
+  bool closed;
+  std::deque<T> q;
+  std::mutex mtx;
+  std::condition_variable notfull, notempty;
+};
+
+#endif
@@ -0,0 +1,96 @@
+//----------------------------------------------------------------------
+// FILE:   EditJournal.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Undo/redo journal for land/sea mask edits.
+//----------------------------------------------------------------------
+
+#include <algorithm>
+using namespace std;
+
+#include "EditJournal.hh"
+
+
+void EditJournal::end(void)
+{
+  grouping = false;
+  commit();
+}
+
+void EditJournal::record(unsigned int idx)
+{
+  pending.push_back(idx);
+  if (!grouping) commit();
+}
+
+void EditJournal::record(const GridData<bool> &changed)
+{
+  const vector<bool> &ch = changed.data();
+  for (unsigned int i = 0; i < ch.size(); ++i)
+    if (ch[i]) pending.push_back(i);
+  if (!grouping) commit();
+}
+
+
+// Turn pending cell indexes into a new entry: sort, cancel out pairs
+// of flips of the same cell, then collect runs.  A new entry discards
+// any entries that had been undone.
+
+void EditJournal::commit(void)
+{
+  if (pending.empty()) return;
+  sort(pending.begin(), pending.end());
+  Delta d;
+  for (unsigned int i = 0; i < pending.size(); ) {
+    unsigned int j = i;
+    while (j < pending.size() && pending[j] == pending[i]) ++j;
+    if ((j - i) % 2 == 1) {
+      unsigned int idx = pending[i];
+      if (!d.empty() && d.back().start + d.back().length == idx)
+        ++d.back().length;
+      else
+        d.push_back(Run(idx, 1));
+    }
+    i = j;
+  }
+  pending.clear();
+  if (d.empty()) return;
+
+  for (size_t i = pos; i < entries.size(); ++i) nruns -= entries[i].size();
+  entries.resize(pos);
+  entries.push_back(Delta());
+  entries.back().swap(d);
+  nruns += entries.back().size();
+  ++pos;
+  size_t drop = 0;
+  while (nruns > limit && drop + 1 < entries.size())
+    nruns -= entries[drop++].size();
+  if (drop > 0) {
+    entries.erase(entries.begin(), entries.begin() + drop);
+    pos -= drop;
+  }
+}
+
+
+const EditJournal::Delta *EditJournal::undo(void)
+{
+  end();
+  if (pos == 0) return 0;
+  return &entries[--pos];
+}
+
+const EditJournal::Delta *EditJournal::redo(void)
+{
+  end();
+  if (pos >= entries.size()) return 0;
+  return &entries[pos++];
+}
+
+void EditJournal::clear(void)
+{
+  entries.clear();
+  pending.clear();
+  pos = nruns = 0;
+  grouping = false;
+}
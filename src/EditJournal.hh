@@ -0,0 +1,71 @@
+//----------------------------------------------------------------------
+// FILE:   EditJournal.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Undo/redo journal for land/sea mask edits.
+//
+// Mask edits only ever flip cells between land and ocean, so each
+// journal entry just records which cells a batch of edits flipped,
+// as runs of flat cell indexes (row * nlon + column).  Flipping the
+// same cells again undoes the batch, and flipping them once more
+// redoes it, so entries need no "before" and "after" copies of the
+// mask.  A cell flipped an even number of times within a batch drops
+// out of the entry altogether.
+//
+// Single-cell edits can be grouped into one entry (e.g. a whole
+// drag stroke) between begin() and end(); edits recorded outside a
+// group make an entry each.
+//----------------------------------------------------------------------
+
+#ifndef _H_EDITJOURNAL_
+#define _H_EDITJOURNAL_
+
+#include <vector>
+#include <cstddef>
+
+#include "GridData.hh"
+
+class EditJournal {
+public:
+  struct Run {
+    Run(unsigned int s = 0, unsigned int l = 0) : start(s), length(l) { }
+    unsigned int start, length;
+  };
+  typedef std::vector<Run> Delta;
+
+  // The journal holds at most maxruns runs in total; the oldest
+  // entries are dropped when the limit is exceeded.
+  EditJournal(std::size_t maxruns = 1 << 20) :
+    pos(0), nruns(0), limit(maxruns), grouping(false) { }
+
+  // Group edits into a single entry.
+  void begin(void) { end();  grouping = true; }
+  void end(void);
+
+  // Record cells flipped by an edit.
+  void record(unsigned int idx);
+  void record(const GridData<bool> &changed);
+
+  // Step back or forward through the journal, returning the cells to
+  // flip, or null if there is nothing to undo or redo.
+  const Delta *undo(void);
+  const Delta *redo(void);
+  bool canUndo(void) const { return pos > 0 || !pending.empty(); }
+  bool canRedo(void) const { return pos < entries.size(); }
+
+  void clear(void);
+  std::size_t runs(void) const { return nruns; }
+
+private:
+  void commit(void);
+
+  std::vector<Delta> entries;   // Entries [0, pos) are applied.
+  std::size_t pos;
+  std::size_t nruns;            // Total runs in all entries.
+  std::size_t limit;
+  bool grouping;
+  std::vector<unsigned int> pending;
+};
+
+#endif
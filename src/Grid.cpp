@@ -49,7 +49,7 @@ Grid::Grid(NcFile &infile)
 
 Grid::Grid(int nlat, double lat0, double dlat,
            int nlon, double lon0, double dlon) :
-  lt(nlat), ln(nlon)
+  lt(nlat), ln(nlon), lt_rev(false), ln_rev(false)
 {
   for (int i = 0; i < nlat; ++i) lt[i] = lat0 + i * dlat;
   for (int i = 0; i < nlon; ++i) ln[i] = lon0 + i * dlon;
@@ -58,13 +58,22 @@ Grid::Grid(int nlat, double lat0, double dlat,
 }
 
 Grid::Grid(vector<double> lats, int nlon, double lon0, double dlon) :
-  lt(lats), ln(nlon)
+  lt(lats), ln(nlon), lt_rev(false), ln_rev(false)
 {
   for (int i = 0; i < nlon; ++i) ln[i] = lon0 + i * dlon;
   if (lt[0] > lt[1]) { reverse(lt.begin(), lt.end()); lt_rev = true; }
   if (ln[0] > ln[1]) { reverse(ln.begin(), ln.end()); ln_rev = true; }
 }
 
+Grid::Grid(vector<double> lats, vector<double> lons) :
+  lt(lats), ln(lons), lt_rev(false), ln_rev(false)
+{
+  if (lt.size() < 2 || ln.size() < 2)
+    throw domain_error("Grid needs at least two latitudes and longitudes");
+  if (lt[0] > lt[1]) { reverse(lt.begin(), lt.end()); lt_rev = true; }
+  if (ln[0] > ln[1]) { reverse(ln.begin(), ln.end()); ln_rev = true; }
+}
+
 
 // Radius of Earth in km.
 const double REARTH = 6370.0;
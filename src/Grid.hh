@@ -11,7 +11,9 @@ public:
   Grid(netCDF::NcFile &infile);
   Grid(int nlat, double lat0, double dlat, int nlon, double lon0, double dlon);
   Grid(std::vector<double> inlat, int nlon, double lon0, double dlon);
-  Grid(const Grid &other) : lt(other.lt), ln(other.ln) { }
+  Grid(std::vector<double> inlat, std::vector<double> inlon);
+  Grid(const Grid &other) :
+    lt(other.lt), ln(other.ln), lt_rev(other.lt_rev), ln_rev(other.ln_rev) { }
 
   unsigned int nlat(void) const { return lt.size(); }
   unsigned int nlon(void) const { return ln.size(); }
@@ -135,7 +135,10 @@ template<typename T> GridData<T>::GridData
   // Read data in one go at original type and cast to output type.
   int n = _nlat * _nlon;
   switch (var.getType().getId()) {
-  case netCDF::NcType::nc_BYTE:
+  case netCDF::NcType::nc_BYTE: {
+    std::vector<signed char> tdata(n);  var.getVar(tdata.data());
+    convert(tdata, _data);  break;
+  }
   case netCDF::NcType::nc_CHAR: {
     std::vector<char> tdata(n);  var.getVar(tdata.data());
     convert(tdata, _data);  break;
@@ -206,7 +209,10 @@ template<typename T> GridData<T>::GridData
         (std::string("Invalid NetCDF missing value for variable '") +
          ncvar + "'");
     switch (missing_att.getType().getId()) {
-    case netCDF::NcType::nc_BYTE:
+    case netCDF::NcType::nc_BYTE: {
+      signed char mval;  missing_att.getValues(&mval);
+      _missing_val = Convert<signed char>()(mval);  break;
+    }
     case netCDF::NcType::nc_CHAR: {
       char mval;  missing_att.getValues(&mval);
       _missing_val = Convert<char>()(mval);  break;
@@ -10,6 +10,9 @@
 #include <wx/colour.h>
 
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
 using namespace std;
 
 #include "IslaCanvas.hh"
@@ -31,6 +34,7 @@ BEGIN_EVENT_TABLE(IslaCanvas, wxWindow)
   EVT_ERASE_BACKGROUND (IslaCanvas::OnEraseBackground)
   EVT_CONTEXT_MENU     (IslaCanvas::OnContextMenu)
   EVT_KEY_DOWN         (IslaCanvas::OnKey)
+  EVT_TIMER            (ID_MOTION_TIMER, IslaCanvas::OnMotionTimer)
   EVT_MENU (ID_CTX_TOGGLE_ISLAND,  IslaCanvas::OnContextMenuEvent)
   EVT_MENU (ID_CTX_COARSEN_ISLAND, IslaCanvas::OnContextMenuEvent)
   EVT_MENU (ID_CTX_REFINE_ISLAND,  IslaCanvas::OnContextMenuEvent)
@@ -38,6 +42,18 @@ BEGIN_EVENT_TABLE(IslaCanvas, wxWindow)
 END_EVENT_TABLE()
 
 
+// Tile ready notification.  This is called on a tile rendering
+// thread, so it just queues a call to TileReady on the UI thread.
+
+struct TileNotify {
+  TileNotify(IslaCanvas *c) : canvas(c) { }
+  void operator()(const TileCache::Key &k) const {
+    canvas->CallAfter(&IslaCanvas::TileReady, k);
+  }
+  IslaCanvas *canvas;
+};
+
+
 // Constructor sets up border sizing, all model-dependent values and
 // canvas size parameters.
 
@@ -46,12 +62,17 @@ IslaCanvas::IslaCanvas(wxWindow *parent, IslaModel *m) :
            wxFULL_REPAINT_ON_RESIZE),
 #ifdef ISLA_DEBUG
   sizingOverlay(false), regionOverlay(false),
-  ismaskOverlay(false), isIslandOverlay(false),
+  ismaskOverlay(false), isIslandOverlay(false), perfOverlay(false),
 #endif
   frame(0),
   mouse(MOUSE_NOTHING), panning(false), zoom_selection(false), edit(false),
-  show_islands(true), show_comparison(true)
+  edtool(EDIT_CELL),
+  show_islands(true), show_comparison(true),
+  tiles(new TileCache(192)), dirty((1 << NLAYERS) - 1), stale(dirty),
+  motionTimer(this, ID_MOTION_TIMER), pandx(0), pandy(0)
 {
+  tiles->setNotify(TileNotify(this));
+
   // Calculate border width and border text offset.
   wxPaintDC dc(this);
   wxCoord th;
@@ -109,8 +130,8 @@ IslaCanvas::IslaCanvas(wxWindow *parent, IslaModel *m) :
 
 void IslaCanvas::loadComparisonIslands(wxString fname)
 {
-  bool ok = model->loadIslands(fname, compisles);
-  Refresh();
+  bool ok = model->loadIslands(string(fname.char_str()), compisles);
+  Invalidate(LAYER_COMPARISON);
   if (!ok) {
     wxMessageDialog msg(frame,
                         _("There may be a problem with the island data.\n"
@@ -126,7 +147,13 @@ void IslaCanvas::loadComparisonIslands(wxString fname)
 
 void IslaCanvas::ModelReset(IslaModel *m, bool refresh)
 {
+  // Drop any pending motion: it refers to the old model.
+  motionTimer.Stop();
+  pandx = pandy = 0;
+  edsamples.clear();
+
   model = m;
+  tiles->setModel(m);
   GridPtr g = model->grid();
 
   // Find minimum longitude and latitude step used in the model grid
@@ -164,109 +191,272 @@ void IslaCanvas::ModelReset(IslaModel *m, bool refresh)
 }
 
 
-// Main paint callback.  In order, renders: grid cells, grid (if
-// visible), axes, borders and any debug overlays.
-//
-// THIS WILL NEED TO BE OPTIMISED.  AT THE MOMENT, IT DOES THE DUMBEST
-// POSSIBLE THING...
+// Set up tile rendering parameters for the current model, scale and
+// colours.
 
-void IslaCanvas::OnPaint(wxPaintEvent &WXUNUSED(event))
+void IslaCanvas::UpdateTileView(void)
 {
-  // Setup: determine minimum region to redraw.
-  GridPtr g = model->grid();
-  int nlon = g->nlon(), nlat = g->nlat();
-  int nhor = static_cast<int>(min(static_cast<double>(nlon),
-                                  mapw / (minDlon * scale) + 1) + 1);
-  int nver = static_cast<int>(min(static_cast<double>(nlat),
-                                  maph / (minDlat * scale) + 6));
-  int lon0 = static_cast<int>(XToLon(0)), lat0 = static_cast<int>(YToLat(maph));
-  int ilon0 = 0, ilat0 = 0;
-  double loni = g->lon(ilon0), loni1 = g->lon((ilon0 + 1) % nlon);
-  while (!(lon0 >= loni && lon0 < loni1 + (loni1 >= loni ? 0 : 360.0))) {
-    ilon0 = (ilon0 + 1) % nlon;
-    loni = g->lon(ilon0);
-    loni1 = g->lon((ilon0 + 1) % nlon);
+  TileCache::View *v = new TileCache::View;
+  v->scale = scale;
+  v->lattop = iclats.back();
+  v->iclons = iclons;
+  v->iclats = iclats;
+  v->level = CellLevel();
+  IslaPreferences *prefs = IslaPreferences::get();
+  wxColour ocean = prefs->getOceanColour(), land = prefs->getLandColour();
+  wxColour island = prefs->getIslandColour();
+  v->ocean[0] = ocean.Red();   v->ocean[1] = ocean.Green();
+  v->ocean[2] = ocean.Blue();
+  v->land[0] = land.Red();     v->land[1] = land.Green();
+  v->land[2] = land.Blue();
+  v->island[0] = island.Red(); v->island[1] = island.Green();
+  v->island[2] = island.Blue();
+  tiles->setView(TileCache::ViewPtr(v));
+}
+
+
+// World pixel coordinates (see TileCache.hh) of the top left corner
+// of the map.
+
+void IslaCanvas::TileOrigin(int &ox, int &oy) const
+{
+  ox = static_cast<int>(floor(clon * scale - mapw / 2));
+  oy = static_cast<int>(floor((iclats.back() - clat) * scale - maph / 2));
+}
+
+
+// Colour used for transparent parts of overlay layers.
+
+static wxColour layerKey(void) { return wxColour(1, 2, 3); }
+
+
+// Fill a rectangle of the map from cached tiles.  Tiles that aren't
+// ready yet are requested from the tile cache and shown in the ocean
+// colour until they arrive (see TileReady), so the time taken here
+// depends only on the size of the rectangle, never on the size of
+// the grid.
+
+void IslaCanvas::RenderCells(wxImage &img, const wxRect &rect)
+{
+  const int T = TileCache::TILE;
+  if (!tiles->view()) UpdateTileView();
+  img.Create(rect.width, rect.height, false);
+  unsigned char *data = img.GetData();
+  const unsigned char *ocean = tiles->view()->ocean;
+  int ox, oy;
+  TileOrigin(ox, oy);
+  int x0 = ox + rect.x, x1 = x0 + rect.width;
+  int y0 = oy + rect.y, y1 = y0 + rect.height;
+  int tx0 = TileCache::tileIndex(x0), tx1 = TileCache::tileIndex(x1 - 1);
+  int ty0 = TileCache::tileIndex(y0), ty1 = TileCache::tileIndex(y1 - 1);
+  CountCells(rect);
+  for (int ty = ty0; ty <= ty1; ++ty)
+    for (int tx = tx0; tx <= tx1; ++tx) {
+      TileCache::PixelsPtr px = tiles->fetch(tx, ty);
+      int xa = max(x0, tx * T), xb = min(x1, (tx + 1) * T);
+      int ya = max(y0, ty * T), yb = min(y1, (ty + 1) * T);
+      for (int y = ya; y < yb; ++y) {
+        unsigned char *dst = data + 3 * ((y - y0) * rect.width + xa - x0);
+        if (px)
+          memcpy(dst, &(*px)[3 * ((y - ty * T) * T + xa - tx * T)],
+                 3 * (xb - xa));
+        else
+          for (int x = xa; x < xb; ++x, dst += 3) memcpy(dst, ocean, 3);
+      }
+    }
+}
+
+
+// Count the grid cells covered by part of the map for rendering
+// statistics.
+
+void IslaCanvas::CountCells(const wxRect &rect)
+{
+  int nlon = model->grid()->nlon();
+  int c0, c1, r0, r1;
+  VisibleCells(rect, c0, c1, r0, r1);
+  int ncols = c1 >= c0 ? c1 - c0 + 1 : c1 + nlon - c0 + 1;
+  stats.cellsVisited(static_cast<unsigned long>(ncols) *
+                     max(0, r1 - r0 + 1));
+}
+
+
+// A tile has been rendered: if it's part of the current view, copy
+// it into the cell layer and repaint it.
+
+void IslaCanvas::TileReady(TileCache::Key k)
+{
+  if (k.scale != scale || (dirty & (1 << LAYER_CELLS))) return;
+  const int T = TileCache::TILE;
+  int ox, oy;
+  TileOrigin(ox, oy);
+  wxRect rect(k.tx * T - ox, k.ty * T - oy, T, T);
+  rect.Intersect(wxRect(0, 0, static_cast<int>(mapw), static_cast<int>(maph)));
+  if (rect.IsEmpty()) return;
+  RenderLayer(LAYER_CELLS, rect);
+  RefreshRect(wxRect(xoff + rect.x, yoff + rect.y, rect.width, rect.height),
+              false);
+}
+
+
+// Invalidate everything, including cached tiles (e.g. after a change
+// of colours).
+
+void IslaCanvas::InvalidateAll(void)
+{
+  UpdateTileView();
+  tiles->clear();
+  dirty = (1 << NLAYERS) - 1;
+  stale = dirty;
+  Refresh();
+}
+
+
+// Is a layer currently displayed?
+
+bool IslaCanvas::LayerVisible(int layer) const
+{
+  switch (layer) {
+  case LAYER_GRID:       return MinCellSize() >= 4;
+  case LAYER_ISLANDS:    return show_islands && !model->islands().empty();
+  case LAYER_COMPARISON: return show_comparison && !compisles.empty();
+  default:               return true;
   }
-  while (g->lat(ilat0) < lat0) ++ilat0;
-  ilat0 = max(0, ilat0 - 3);
-  wxPaintDC dc(this);
+}
 
-  // Clear grid cell and axis areas.
-  dc.SetBrush(*wxWHITE_BRUSH);
-  int imapw = static_cast<int>(mapw), imaph = static_cast<int>(maph);
-  dc.DrawRectangle(xoff, yoff - bw, imapw, bw);
-  dc.DrawRectangle(xoff, yoff + imaph, imapw, bw);
-  dc.DrawRectangle(xoff - bw, yoff, bw, imaph);
-  dc.DrawRectangle(xoff + imapw, yoff, bw, imaph);
-  dc.SetBrush(wxBrush(IslaPreferences::get()->getOceanColour()));
-  dc.DrawRectangle(xoff, yoff, imapw, imaph);
 
-  // Set clip region for grid cells and grid.
-  dc.SetClippingRegion(xoff, yoff, imapw, imaph);
+// Render part of a map layer (or all of the axis layer) into the
+// layer bitmap.  Overlay layers are drawn over the transparency key
+// colour, and the drawing code for them works in canvas coordinates,
+// so the device origin is shifted to put the map origin at the top
+// left of the layer bitmap.
 
-  // Fill grid cells.
+void IslaCanvas::RenderLayer(int layer, const wxRect &rect)
+{
+  RenderStats::Timer timer(stats, layer);
+  if (layer == LAYER_CELLS) {
+    wxImage img;
+    RenderCells(img, rect);
+    wxMemoryDC dc(layers[layer]);
+    dc.DrawBitmap(wxBitmap(img), rect.x, rect.y, false);
+    stats.drawCalls(1);
+    return;
+  }
+  wxMemoryDC dc(layers[layer]);
+  if (layer == LAYER_AXES) { RenderAxes(dc);  return; }
+
+  dc.SetDeviceOrigin(-xoff, -yoff);
+  dc.SetClippingRegion(xoff + rect.x, yoff + rect.y, rect.width, rect.height);
   dc.SetPen(*wxTRANSPARENT_PEN);
-  wxBrush land(IslaPreferences::get()->getLandColour());
-  wxBrush island(IslaPreferences::get()->getIslandColour());
-  for (int i = 0, c = ilon0; i < nhor; ++i, c = (c + 1) % nlon)
-    for (int j = 0, r = ilat0; j < nver && r < nlat; ++j, ++r)
-      if (model->maskVal(r, c)) {
-        dc.SetBrush(model->isIsland(r, c) ? island : land);
-        int xl = static_cast<int>(lonToX(iclons[c]));
-        int xr = static_cast<int>(lonToX(iclons[(c+1)%nlon]));
-        int yt = static_cast<int>(max(0.0, latToY(iclats[r])));
-        int yb = static_cast<int>(min(latToY(iclats[r+1]), canh));
-        if (xl <= xr)
-          dc.DrawRectangle(xoff + xl, yoff + yt, xr-xl, yb-yt);
-        else {
-          dc.DrawRectangle(xoff + xl, yoff + yt, imapw-xl, yb-yt);
-          dc.DrawRectangle(xoff, yoff + yt, xr, yb-yt);
-        }
-      }
+  dc.SetBrush(wxBrush(layerKey()));
+  dc.DrawRectangle(xoff + rect.x, yoff + rect.y, rect.width, rect.height);
   dc.SetBrush(*wxTRANSPARENT_BRUSH);
-
-  // Draw grid.
-  if (MinCellSize() >= 4) {
-    dc.SetPen(wxPen(IslaPreferences::get()->getGridColour()));
-    for (int i = 0, c = ilon0; i <= nhor; ++i, c = (c + 1) % nlon) {
+  stats.drawCalls(1);
+  IslaPreferences *prefs = IslaPreferences::get();
+  switch (layer) {
+  case LAYER_GRID: {
+    GridPtr g = model->grid();
+    int nlon = g->nlon(), nlat = g->nlat();
+    int imapw = static_cast<int>(mapw), imaph = static_cast<int>(maph);
+    dc.SetPen(wxPen(prefs->getGridColour()));
+    unsigned long nlines = 0;
+    for (int c = 0; c < nlon; ++c) {
       int x = static_cast<int>(lonToX(iclons[c]));
-      if (x >= 0 && x <= mapw)
+      if (x >= 0 && x <= mapw) {
         dc.DrawLine(xoff + x, yoff, xoff + x, yoff + imaph);
+        ++nlines;
+      }
     }
-    for (int i = 0, r = ilat0; i <= nver && r <= nlat; ++i, ++r) {
+    for (int r = 0; r <= nlat; ++r) {
       int y = static_cast<int>(latToY(iclats[r]));
-      if (y >= 0 && y <= maph)
+      if (y >= 0 && y <= maph) {
         dc.DrawLine(xoff, yoff + y, xoff + imapw, yoff + y);
+        ++nlines;
+      }
     }
+    stats.drawCalls(nlines);
+    break;
+  }
+  case LAYER_ISLANDS: {
+    vector<const OutlineIndex::Item *> els;
+    QueryOutlines(LAYER_ISLANDS, rect, els);
+    wxPen p(prefs->getIslandOutlineColour(), 3);
+    wxBrush vb(prefs->getIslandOutlineColour(), wxHORIZONTAL_HATCH);
+    wxBrush hb(prefs->getIslandOutlineColour(), wxVERTICAL_HATCH);
+    stats.drawCalls(drawOutlines(dc, p, vb, hb, els));
+    break;
   }
+  case LAYER_COMPARISON: {
+    vector<const OutlineIndex::Item *> els;
+    QueryOutlines(LAYER_COMPARISON, rect, els);
+    wxPen p(prefs->getCompOutlineColour(), 3, wxSHORT_DASH);
+    wxBrush vb(prefs->getCompOutlineColour(), wxHORIZONTAL_HATCH);
+    wxBrush hb(prefs->getCompOutlineColour(), wxVERTICAL_HATCH);
+    stats.drawCalls(drawOutlines(dc, p, vb, hb, els));
+    break;
+  }
+  }
+}
 
-  // Draw island segments.
-  if (show_islands && model->islands().size() > 0) {
-    const map<LMass, IslaModel::IslandInfo> &isles = model->islands();
-    wxPen p(IslaPreferences::get()->getIslandOutlineColour(), 3);
-    wxBrush vb(IslaPreferences::get()->getIslandOutlineColour(),
-               wxHORIZONTAL_HATCH);
-    wxBrush hb(IslaPreferences::get()->getIslandOutlineColour(),
-               wxVERTICAL_HATCH);
-    for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
-           isles.begin(); it != isles.end(); ++it)
-      drawIsland(dc, p, vb, hb, it->second);
-  }
-
-  // Draw island comparison segments.
-  if (show_comparison && compisles.size() > 0) {
-    wxPen p(IslaPreferences::get()->getCompOutlineColour(), 3, wxSHORT_DASH);
-    wxBrush vb(IslaPreferences::get()->getCompOutlineColour(),
-               wxHORIZONTAL_HATCH);
-    wxBrush hb(IslaPreferences::get()->getCompOutlineColour(),
-               wxVERTICAL_HATCH);
-    for (vector<IslaModel::IslandInfo>::const_iterator it =
-           compisles.begin(); it != compisles.end(); ++it)
-      drawIsland(dc, p, vb, hb, *it);
-  }
-
-  // Draw axes.
-  dc.DestroyClippingRegion();
+
+// Range of grid cells covering part of the map (in map pixel
+// coordinates).  The column range wraps round if c1 < c0.
+
+void IslaCanvas::VisibleCells(const wxRect &rect,
+                              int &c0, int &c1, int &r0, int &r1)
+{
+  GridPtr g = model->grid();
+  int nlon = g->nlon(), nlat = g->nlat();
+  c0 = 0;  c1 = nlon - 1;
+  if (rect.width / scale + 2 * minDlon < 360.0) {
+    c0 = lonToCol(XToLon(rect.x));
+    c1 = lonToCol(XToLon(rect.x + rect.width));
+  }
+  double latt = YToLat(rect.y), latb = YToLat(rect.y + rect.height);
+  r0 = latb < iclats[0] ? 0 : latToRow(latb);
+  r1 = latt >= iclats[nlat] ? nlat - 1 : latToRow(latt);
+  if (r0 < 0) r0 = nlat - 1;
+  if (r1 < 0) r1 = 0;
+}
+
+
+// Find the outline elements of the island or comparison layer that
+// intersect part of the map, rebuilding the layer's outline index
+// first if the islands have changed.
+
+void IslaCanvas::QueryOutlines(int layer, const wxRect &rect,
+                               vector<const OutlineIndex::Item *> &els)
+{
+  GridPtr g = model->grid();
+  int nlon = g->nlon(), nlat = g->nlat();
+  OutlineIndex &idx = layer == LAYER_ISLANDS ? islindex : compindex;
+  if (stale & (1 << layer)) {
+    if (layer == LAYER_ISLANDS) idx.build(nlon, nlat, model->islands());
+    else idx.build(nlon, nlat, compisles);
+    stale &= ~(1 << layer);
+  }
+  int c0, c1, r0, r1;
+  VisibleCells(rect, c0, c1, r0, r1);
+  idx.query(c0, c1, r0, r1, els);
+}
+
+
+// Render axis layer: background, axis borders and labels.
+
+void IslaCanvas::RenderAxes(wxDC &dc)
+{
+  dc.SetFont(GetFont());
+  dc.SetBackground(wxBrush(GetBackgroundColour()));
+  dc.Clear();
+  dc.SetPen(*wxBLACK_PEN);
+  dc.SetBrush(*wxWHITE_BRUSH);
+  int imapw = static_cast<int>(mapw), imaph = static_cast<int>(maph);
+  dc.DrawRectangle(xoff, yoff - bw, imapw, bw);
+  dc.DrawRectangle(xoff, yoff + imaph, imapw, bw);
+  dc.DrawRectangle(xoff - bw, yoff, bw, imaph);
+  dc.DrawRectangle(xoff + imapw, yoff, bw, imaph);
+  stats.drawCalls(5 + taxpos.size() + baxpos.size() +
+                  laxpos.size() + raxpos.size());
   dc.SetClippingRegion(taxis);
   axisLabels(dc, true, yoff - bw + boff, taxpos, taxlab);
   dc.DestroyClippingRegion();
@@ -280,16 +470,228 @@ void IslaCanvas::OnPaint(wxPaintEvent &WXUNUSED(event))
   dc.SetClippingRegion(raxis);
   axisLabels(dc, false, static_cast<int>(canw - xoff + 1.5 * boff),
              raxpos, raxlab);
-
-  // Draw borders.
   dc.DestroyClippingRegion();
-  dc.SetBrush(*wxTRANSPARENT_BRUSH);
-  dc.SetPen(*wxBLACK_PEN);
-  dc.DrawRectangle(xoff, yoff - bw, imapw, imaph + bw * 2);
-  dc.DrawRectangle(xoff - bw, yoff, imapw + bw * 2, imaph);
+}
+
+
+// Rebuild the transparency mask of an overlay layer after drawing.
+
+void IslaCanvas::MaskLayer(int layer)
+{
+  if (layer != LAYER_CELLS && layer != LAYER_AXES)
+    layers[layer].SetMask(new wxMask(layers[layer], layerKey()));
+}
+
+
+// Re-render all invalid layers that are currently displayed.
+// Hidden layers stay invalid until they are next shown.
+
+void IslaCanvas::UpdateLayers(void)
+{
+  int imapw = static_cast<int>(mapw), imaph = static_cast<int>(maph);
+  for (int l = 0; l < NLAYERS; ++l) {
+    if (!(dirty & (1 << l)) || !LayerVisible(l)) continue;
+    if (l == LAYER_AXES)
+      layers[l].Create(static_cast<int>(canw), static_cast<int>(canh));
+    else
+      layers[l].Create(imapw, imaph);
+    RenderLayer(l, wxRect(0, 0, layers[l].GetWidth(), layers[l].GetHeight()));
+    MaskLayer(l);
+    dirty &= ~(1 << l);
+  }
+}
+
+
+// Scroll the cached map layers after a pan by (dx, dy) pixels,
+// rendering only the newly exposed strips.  If the shift isn't a
+// whole number of pixels or is bigger than the map, the map layers
+// are redrawn in full instead.
+
+void IslaCanvas::ScrollLayers(int dx, int dy, bool exact)
+{
+  int imapw = static_cast<int>(mapw), imaph = static_cast<int>(maph);
+  int maplayers = (1 << LAYER_AXES) - 1;
+  if (!exact || abs(dx) >= imapw || abs(dy) >= imaph) {
+    dirty |= maplayers;
+    return;
+  }
+  if (dx == 0 && dy == 0) return;
+  vector<wxRect> exposed;
+  if (dx > 0) exposed.push_back(wxRect(0, 0, dx, imaph));
+  if (dx < 0) exposed.push_back(wxRect(imapw + dx, 0, -dx, imaph));
+  if (dy > 0) exposed.push_back(wxRect(0, 0, imapw, dy));
+  if (dy < 0) exposed.push_back(wxRect(0, imaph + dy, imapw, -dy));
+  for (int l = 0; l < LAYER_AXES; ++l) {
+    if (dirty & (1 << l)) continue;
+    if (!LayerVisible(l)) { dirty |= 1 << l;  continue; }
+    wxBitmap old = layers[l];
+    layers[l] = wxBitmap(imapw, imaph);
+    {
+      wxMemoryDC dc(layers[l]);
+      dc.DrawBitmap(old, dx, dy, false);
+    }
+    for (vector<wxRect>::const_iterator it = exposed.begin();
+         it != exposed.end(); ++it)
+      RenderLayer(l, *it);
+    MaskLayer(l);
+  }
+}
+
+
+// Redraw a block of grid cells (rows r0 to r1 and columns c0 to c1,
+// inclusive, without wraparound) after an edit.  Cached tiles
+// covering the block are dropped, and only the block's part of the
+// cell layer is re-rendered (synchronously, so the edit shows
+// immediately) and repainted.  When zoomed out, the block is
+// extended to whole cells of the pyramid level in use.
+
+void IslaCanvas::RefreshCells(int r0, int r1, int c0, int c1)
+{
+  if (r0 < 0 || c0 < 0) return;
+  GridPtr g = model->grid();
+  int nlon = g->nlon(), nlat = g->nlat();
+  int level = CellLevel();
+  c0 = (c0 >> level) << level;  c1 = min(((c1 >> level) + 1) << level, nlon);
+  r0 = (r0 >> level) << level;  r1 = min(((r1 >> level) + 1) << level, nlat);
+  tiles->invalidate(iclons[c0], iclons[c1], iclats[r0], iclats[r1]);
+  if (dirty & (1 << LAYER_CELLS)) { Refresh();  return; }
+
+  // Screen rectangles for the block, allowing a pixel extra all
+  // round for rounding differences between tile and canvas
+  // coordinates.
+  int imapw = static_cast<int>(mapw), imaph = static_cast<int>(maph);
+  int xl = static_cast<int>(lonToX(iclons[c0])) - 1;
+  int xr = static_cast<int>(lonToX(iclons[c1 % nlon])) + 1;
+  int yt = static_cast<int>(max(0.0, latToY(iclats[r1]))) - 1;
+  int yb = static_cast<int>(min(latToY(iclats[r0]), maph)) + 1;
+  vector<wxRect> rects;
+  if (xl <= xr)
+    rects.push_back(wxRect(xl, yt, xr - xl, yb - yt));
+  else {
+    rects.push_back(wxRect(xl, yt, imapw - xl, yb - yt));
+    rects.push_back(wxRect(0, yt, xr, yb - yt));
+  }
+  int ox, oy;
+  TileOrigin(ox, oy);
+  wxRect maprect(0, 0, imapw, imaph);
+  RenderStats::Timer timer(stats, RenderStats::CELLS);
+  stats.cellsVisited((c1 - c0) * (r1 - r0));
+  for (vector<wxRect>::iterator it = rects.begin(); it != rects.end(); ++it) {
+    it->Intersect(maprect);
+    if (it->IsEmpty()) continue;
+    stats.drawCalls(1);
+    wxImage img(it->width, it->height, false);
+    TileCache::render(*tiles->view(), *model, ox + it->x, oy + it->y,
+                      it->width, it->height, img.GetData());
+    {
+      wxMemoryDC dc(layers[LAYER_CELLS]);
+      dc.DrawBitmap(wxBitmap(img), it->x, it->y, false);
+    }
+    RefreshRect(wxRect(xoff + it->x, yoff + it->y, it->width, it->height),
+                false);
+  }
+}
+
+
+// Redraw a block of grid cells whose columns may run past either end
+// of the grid, splitting it at the edge of the grid if needed.
+
+void IslaCanvas::RefreshCellSpan(int r0, int r1, int c0, int c1)
+{
+  int nlon = model->grid()->nlon();
+  if (c1 - c0 + 1 >= nlon) {
+    RefreshCells(r0, r1, 0, nlon - 1);
+    return;
+  }
+  c0 = (c0 % nlon + nlon) % nlon;  c1 = (c1 % nlon + nlon) % nlon;
+  if (c0 <= c1)
+    RefreshCells(r0, r1, c0, c1);
+  else {
+    RefreshCells(r0, r1, c0, nlon - 1);
+    RefreshCells(r0, r1, 0, c1);
+  }
+}
+
+
+// Redraw the landmasses changed by the model's last recalculation
+// after an edit, undo or redo, leaving the rest of the tile cache
+// alone.
+
+void IslaCanvas::RefreshChanged(void)
+{
+  const vector<Rect> &boxes = model->changedBoxes();
+  for (vector<Rect>::const_iterator it = boxes.begin();
+       it != boxes.end(); ++it)
+    RefreshCellSpan(it->y, it->y + it->height - 1,
+                    it->x, it->x + it->width - 1);
+}
+
+
+// Copy the part of a cached layer covering a canvas rectangle.  The
+// layer's top left corner is at (ox, oy) in canvas coordinates.
+
+void IslaCanvas::BlitLayer(wxDC &dc, int layer, const wxRect &rect,
+                           int ox, int oy)
+{
+  wxMemoryDC src(layers[layer]);
+  stats.drawCalls(1);
+  dc.Blit(rect.x, rect.y, rect.width, rect.height, &src,
+          rect.x - ox, rect.y - oy, wxCOPY,
+          layer != LAYER_CELLS && layer != LAYER_AXES);
+}
+
+
+// Main paint callback.  Brings any invalid cached layers up to date,
+// then composites, in order: axes, grid cells, grid (if visible),
+// model and comparison islands, borders and any debug overlays.
+// Only the parts of the layers within the update region are copied.
+
+void IslaCanvas::OnPaint(wxPaintEvent &WXUNUSED(event))
+{
+  wxPaintDC dc(this);
+  int imapw = static_cast<int>(mapw), imaph = static_cast<int>(maph);
+  if (imapw <= 0 || imaph <= 0) return;
+  UpdateLayers();
+
+  // Composite layers and draw borders.
+  {
+    RenderStats::Timer timer(stats, RenderStats::COMPOSITE);
+    wxRect maprect(xoff, yoff, imapw, imaph);
+    for (wxRegionIterator upd(GetUpdateRegion()); upd; ++upd) {
+      wxRect rect = upd.GetRect();
+      BlitLayer(dc, LAYER_AXES, rect, 0, 0);
+      rect.Intersect(maprect);
+      if (rect.IsEmpty()) continue;
+      for (int l = LAYER_CELLS; l < LAYER_AXES; ++l)
+        if (LayerVisible(l)) BlitLayer(dc, l, rect, xoff, yoff);
+    }
+    dc.SetBrush(*wxTRANSPARENT_BRUSH);
+    dc.SetPen(*wxBLACK_PEN);
+    dc.DrawRectangle(xoff, yoff - bw, imapw, imaph + bw * 2);
+    dc.DrawRectangle(xoff - bw, yoff, imapw + bw * 2, imaph);
+    stats.drawCalls(2);
+  }
+  stats.endFrame();
 
 #ifdef ISLA_DEBUG
-  // Debug overlays.
+  // Debug overlays: determine visible cell range.
+  GridPtr g = model->grid();
+  int nlon = g->nlon(), nlat = g->nlat();
+  int nhor = static_cast<int>(min(static_cast<double>(nlon),
+                                  mapw / (minDlon * scale) + 1) + 1);
+  int nver = static_cast<int>(min(static_cast<double>(nlat),
+                                  maph / (minDlat * scale) + 6));
+  int lon0 = static_cast<int>(XToLon(0)), lat0 = static_cast<int>(YToLat(maph));
+  int ilon0 = 0, ilat0 = 0;
+  double loni = g->lon(ilon0), loni1 = g->lon((ilon0 + 1) % nlon);
+  while (!(lon0 >= loni && lon0 < loni1 + (loni1 >= loni ? 0 : 360.0))) {
+    ilon0 = (ilon0 + 1) % nlon;
+    loni = g->lon(ilon0);
+    loni1 = g->lon((ilon0 + 1) % nlon);
+  }
+  while (g->lat(ilat0) < lat0) ++ilat0;
+  ilat0 = max(0, ilat0 - 3);
+
   int cs = static_cast<int>(MinCellSize());
   wxCoord tw, th;
   dc.SetFont(*wxSWISS_FONT);
@@ -353,74 +755,143 @@ void IslaCanvas::OnPaint(wxPaintEvent &WXUNUSED(event))
     txt.Printf(_("mapw=%d maph=%d"), imapw, imaph);
     dc.DrawText(txt, x, y + th * l++);
   }
+  if (perfOverlay) drawPerfOverlay(dc);
 #endif
 }
 
 
-// Draw a single island.
+#ifdef ISLA_DEBUG
+// Performance overlay: timings and work counts for the last frame,
+// split by phase, and a histogram of recent frame times.
+
+void IslaCanvas::drawPerfOverlay(wxDC &dc)
+{
+  const RenderStats::Frame &f = stats.last();
+  vector<wxString> lines;
+  wxString txt;
+  txt.Printf(_("frame %.2f ms"), f.total);
+  lines.push_back(txt);
+  for (int p = 0; p < RenderStats::NPHASES; ++p) {
+    txt.Printf(_("  %s %.2f ms"),
+               wxString::FromAscii(RenderStats::phaseName(p)).c_str(),
+               f.t[p]);
+    lines.push_back(txt);
+  }
+  txt.Printf(_("draw calls %lu"), f.drawcalls);
+  lines.push_back(txt);
+  txt.Printf(_("cells %lu"), f.cells);
+  lines.push_back(txt);
+  if (stats.tracing()) lines.push_back(_("tracing"));
+
+  dc.SetFont(*wxSWISS_FONT);
+  dc.SetTextForeground(*wxBLACK);
+  wxCoord tw, th, boxw = 0;
+  for (unsigned int i = 0; i < lines.size(); ++i) {
+    dc.GetTextExtent(lines[i], &tw, &th);
+    boxw = max(boxw, tw);
+  }
+  const int nb = RenderStats::NBUCKETS, histh = 40;
+  int barw = max(static_cast<int>(boxw / nb), th);
+  boxw = max(boxw, static_cast<wxCoord>(nb * barw));
+  int boxh = th * (lines.size() + 1) + histh;
+  int x = xoff + static_cast<int>(mapw) - boxw - 15, y = yoff + 10;
+  dc.SetPen(*wxBLACK_PEN);
+  dc.SetBrush(*wxWHITE_BRUSH);
+  dc.DrawRectangle(x - 5, y - 5, boxw + 10, boxh + 10);
+  for (unsigned int i = 0; i < lines.size(); ++i)
+    dc.DrawText(lines[i], x, y + th * i);
+
+  // Histogram bars, labelled with bucket upper bounds (ms).
+  vector<int> counts;
+  stats.histogram(counts);
+  int ybase = y + th * lines.size() + histh;
+  dc.SetBrush(*wxGREY_BRUSH);
+  for (int b = 0; b < nb; ++b) {
+    int h = stats.frames() > 0 ? histh * counts[b] / stats.frames() : 0;
+    if (h > 0) dc.DrawRectangle(x + b * barw, ybase - h, barw - 1, h);
+    if (b < nb - 1)
+      txt.Printf(_("%.0f"), RenderStats::BUCKETS[b]);
+    else
+      txt = _("+");
+    dc.DrawText(txt, x + b * barw, ybase);
+  }
+}
+#endif
+
+
+// Draw island outline elements: segment outlines with the pen, then
+// vertical and horizontal coincidence hatching with the brushes.
+// Returns the number of rectangles drawn.
 
-void IslaCanvas::drawIsland(wxDC &dc, wxPen &p, wxBrush &vb, wxBrush &hb,
-                            const IslaModel::IslandInfo &isl)
+int IslaCanvas::drawOutlines(wxDC &dc, wxPen &p, wxBrush &vb, wxBrush &hb,
+                              const vector<const OutlineIndex::Item *> &els)
 {
   GridPtr g = model->grid();
   int nlon = g->nlon(), nlat = g->nlat();
-  const vector<wxRect> &segs = isl.segments;
+  vector<const OutlineIndex::Item *>::const_iterator it;
+  int n = 0;
   dc.SetPen(p);
-  for (vector<wxRect>::const_iterator jt = segs.begin();
-       jt != segs.end(); ++jt) {
+  for (it = els.begin(); it != els.end(); ++it) {
+    if ((*it)->kind != OutlineIndex::SEGMENT) continue;
+    const Rect *jt = &(*it)->seg;
     int xl = static_cast<int>(lonToX(g->lon((jt->x-1 + nlon) % nlon)));
     int xr = static_cast<int>(lonToX(g->lon((jt->x-1 + jt->width) % nlon)));
     int yb = static_cast<int>(min(latToY(g->lat(max(0, jt->y-1))), canh));
     int yt = jt->y-1 + jt->height >= nlat ?
       0 : static_cast<int>(max(0.0, latToY(g->lat(jt->y-1 + jt->height))));
-    if (xl < xr)
+    if (xl < xr) {
       dc.DrawRectangle(xoff + xl, yoff + yt, xr-xl, yb-yt);
-    else {
+      ++n;
+    } else {
       dc.DrawRectangle(xoff + xl, yoff + yt,
                        static_cast<int>(mapw)-xl+5, yb-yt);
       dc.DrawRectangle(xoff, yoff + yt, xr, yb-yt);
+      n += 2;
     }
   }
   dc.SetPen(*wxTRANSPARENT_PEN);
   dc.SetBrush(vb);
-  const IslaModel::CoincInfo &vhatch = isl.vcoinc;
   int dx = static_cast<int>(lonToX(iclons[2]) - lonToX(iclons[1]));
-  for (IslaModel::CoincInfo::const_iterator vit = vhatch.begin();
-       vit != vhatch.end(); ++vit) {
-    int x = static_cast<int>(lonToX(g->lon((vit->first-1 + nlon) % nlon)));
-    int yb = static_cast<int>(min(latToY(g->lat(vit->second.first-1)), canh));
-    int yt = vit->second.second >= nlat ?
-      0 : static_cast<int>(latToY(g->lat(vit->second.second-1)));
+  for (it = els.begin(); it != els.end(); ++it) {
+    const OutlineIndex::Item *vit = *it;
+    if (vit->kind != OutlineIndex::VCOINC) continue;
+    int x = static_cast<int>(lonToX(g->lon((vit->pos-1 + nlon) % nlon)));
+    int yb = static_cast<int>(min(latToY(g->lat(vit->lo-1)), canh));
+    int yt = vit->hi >= nlat ?
+      0 : static_cast<int>(latToY(g->lat(vit->hi-1)));
     int xl = x - dx / 2, xr = x + dx / 2;
-    if (xl < xr)
+    if (xl < xr) {
       dc.DrawRectangle(xoff + xl, yoff + yt, xr-xl, yb-yt);
-    else {
+      ++n;
+    } else {
       dc.DrawRectangle(xoff + xl, yoff + yt,
                        static_cast<int>(mapw)-xl+5, yb-yt);
       dc.DrawRectangle(xoff, yoff + yt, xr, yb-yt);
+      n += 2;
     }
   }
   dc.SetBrush(hb);
-  const IslaModel::CoincInfo &hhatch = isl.hcoinc;
-  for (IslaModel::CoincInfo::const_iterator hit = hhatch.begin();
-       hit != hhatch.end(); ++hit) {
-    int y = static_cast<int>(min(latToY(g->lat(hit->first-1)), canh));
-    int dy = static_cast<int>(latToY(g->lat(hit->first-1)) -
-                              latToY(g->lat(hit->first)));
-    int xl = static_cast<int>(lonToX(g->lon((hit->second.first-1 +
-                                             nlon) % nlon)));
-    int xr = static_cast<int>(lonToX(g->lon((hit->second.second-1 +
-                                             nlon) % nlon)));
+  for (it = els.begin(); it != els.end(); ++it) {
+    const OutlineIndex::Item *hit = *it;
+    if (hit->kind != OutlineIndex::HCOINC) continue;
+    int y = static_cast<int>(min(latToY(g->lat(hit->pos-1)), canh));
+    int dy = static_cast<int>(latToY(g->lat(hit->pos-1)) -
+                              latToY(g->lat(hit->pos)));
+    int xl = static_cast<int>(lonToX(g->lon((hit->lo-1 + nlon) % nlon)));
+    int xr = static_cast<int>(lonToX(g->lon((hit->hi-1 + nlon) % nlon)));
     int yt = y - dy / 2, yb = y + dy / 2;
-    if (xl < xr)
+    if (xl < xr) {
       dc.DrawRectangle(xoff + xl, yoff + yt, xr-xl, yb-yt);
-    else {
+      ++n;
+    } else {
       dc.DrawRectangle(xoff + xl, yoff + yt,
                        static_cast<int>(mapw)-xl+5, yb-yt);
       dc.DrawRectangle(xoff, yoff + yt, xr, yb-yt);
+      n += 2;
     }
   }
   dc.SetBrush(*wxTRANSPARENT_BRUSH);
+  return n;
 }
 
 
@@ -439,8 +910,9 @@ void IslaCanvas::OnMouse(wxMouseEvent &event)
   bool ypanevent = laxis.Contains(x, y) || raxis.Contains(x, y);
   bool xpanevent = taxis.Contains(x, y) || baxis.Contains(x, y);
   if (event.GetEventType() == wxEVT_MOUSEWHEEL) {
-    if (xpanevent) Pan(static_cast<int>(0.25 * event.GetWheelRotation()), 0);
-    else           Pan(0, static_cast<int>(0.25 * event.GetWheelRotation()));
+    int d = static_cast<int>(0.25 * event.GetWheelRotation());
+    if (xpanevent) QueuePan(d, 0);
+    else           QueuePan(0, d);
   } else if (xpanevent || ypanevent || panning)
     ProcessPan(event, xpanevent, ypanevent);
   else if (zoom_selection) ProcessZoomSelection(event);
@@ -462,14 +934,15 @@ void IslaCanvas::ProcessPan(wxMouseEvent &event, bool xpan, bool ypan)
     else
       mouse = xpan ? MOUSE_PAN_X : MOUSE_PAN_Y;
   } else if (!event.LeftIsDown()) {
+    FlushMotion();
     mouse = MOUSE_NOTHING;
     return;
   } else {
     switch(mouse) {
     case MOUSE_NOTHING: return;
-    case MOUSE_PAN_X:  Pan(x - mousex, 0);          break;
-    case MOUSE_PAN_Y:  Pan(0, y - mousey);          break;
-    case MOUSE_PAN_2D: Pan(x - mousex, y - mousey); break;
+    case MOUSE_PAN_X:  QueuePan(x - mousex, 0);          break;
+    case MOUSE_PAN_Y:  QueuePan(0, y - mousey);          break;
+    case MOUSE_PAN_2D: QueuePan(x - mousex, y - mousey); break;
     default: break;
     }
   }
@@ -513,25 +986,230 @@ void IslaCanvas::ProcessZoomSelection(wxMouseEvent &event)
 
 void IslaCanvas::ProcessEdit(wxMouseEvent &event)
 {
+  if (edtool != EDIT_CELL) { ProcessRegionEdit(event);  return; }
   int x = event.GetX(), y = event.GetY();
   if (x < bw || x > canw - bw || y < bw || y > canh - bw) return;
+  int col = lonToCol(XToLon(x - bw)), row = latToRow(YToLat(y - bw));
   if (event.LeftDown()) {
-    double edlon = XToLon(x - bw), edlat = YToLat(y - bw);
-    edcol = lonToCol(edlon);
-    edrow = latToRow(edlat);
+    FlushMotion();
+    if (row < 0 || col < 0) return;
+    edcol = col;  edrow = row;
+    lock_guard<shared_mutex> lock(tiles->modelLock());
+    model->beginEdit();
     model->setMask(edrow, edcol, !model->maskVal(edrow, edcol));
     edval = model->maskVal(edrow, edcol);
     mouse = MOUSE_EDIT;
-    Refresh();
+    RefreshCells(edrow, edrow, edcol, edcol);
   } else if (event.LeftIsDown() && mouse == MOUSE_EDIT) {
-    double edlon = XToLon(x - bw), edlat = YToLat(y - bw);
-    int newedcol = lonToCol(edlon), newedrow = latToRow(edlat);
-    if (newedcol != edcol || newedrow != edrow) {
-      edcol = newedcol;  edrow = newedrow;
-      model->setMask(edrow, edcol, edval);
-      Refresh();
+    if (row < 0 || col < 0) return;
+    edsamples.push_back(make_pair(col, row));
+    ScheduleMotion();
+  } else {
+    FlushMotion();
+    if (mouse == MOUSE_EDIT) {
+      {
+        lock_guard<shared_mutex> lock(tiles->modelLock());
+        model->endEdit();
+      }
+      RefreshChanged();
+      Invalidate(LAYER_ISLANDS);
+    }
+    mouse = MOUSE_NOTHING;
+  }
+}
+
+
+// Region edit tools.  Rectangle and lasso outlines are rubber-banded
+// while dragging and the edit is applied when the button is
+// released; fill applies on a single click.  In each case the new
+// cell value is the opposite of the value of the starting cell, and
+// all selected cells are changed in a single batch.
+
+void IslaCanvas::ProcessRegionEdit(wxMouseEvent &event)
+{
+  int x = event.GetX(), y = event.GetY();
+  if (event.LeftDown()) {
+    if (x < bw || x > canw - bw || y < bw || y > canh - bw) return;
+    int col = lonToCol(XToLon(x - bw)), row = latToRow(YToLat(y - bw));
+    if (row < 0 || col < 0) return;
+    if (edtool == EDIT_FILL) {
+      GridData<bool> sel(model->grid(), false);
+      model->selectConnected(row, col, sel);
+      ApplyRegionEdit(sel, !model->maskVal(row, col));
+      return;
     }
-  } else { mouse = MOUSE_NOTHING;  return; }
+    edcol = col;  edrow = row;
+    edpoly.assign(1, wxPoint(x, y));
+    mouse = MOUSE_EDIT_REGION;
+    return;
+  }
+  if (mouse != MOUSE_EDIT_REGION) return;
+
+  // Erase the previous outline, then update and redraw it.
+  wxClientDC dc(this);
+  DrawEditOutline(dc);
+  if (event.LeftIsDown()) {
+    if (edtool == EDIT_RECT) edpoly.resize(1);
+    if (edpoly.back() != wxPoint(x, y)) edpoly.push_back(wxPoint(x, y));
+    DrawEditOutline(dc);
+    return;
+  }
+  mouse = MOUSE_NOTHING;
+  if (edtool == EDIT_RECT) edpoly.resize(1);
+  edpoly.push_back(wxPoint(x, y));
+
+  GridData<bool> sel(model->grid(), false);
+  if (edtool == EDIT_RECT) {
+    int xl = min(edpoly[0].x, x), xr = max(edpoly[0].x, x);
+    int r0 = latToRow(YToLat(max(edpoly[0].y, y) - bw));
+    int r1 = latToRow(YToLat(min(edpoly[0].y, y) - bw));
+    if (r0 < 0) r0 = 0;
+    if (r1 < 0) r1 = model->grid()->nlat() - 1;
+    model->selectRect(r0, lonToCol(XToLon(xl - bw)),
+                      r1, lonToCol(XToLon(xr - bw)), sel);
+  } else {
+    vector<pair<double, double> > lonlat;
+    for (vector<wxPoint>::const_iterator it = edpoly.begin();
+         it != edpoly.end(); ++it)
+      lonlat.push_back(make_pair(XToLon(it->x - bw), YToLat(it->y - bw)));
+    model->selectPolygon(lonlat, sel);
+  }
+  edpoly.clear();
+  ApplyRegionEdit(sel, !model->maskVal(edrow, edcol));
+}
+
+
+// Draw (or, since it's drawn inverted, erase) the current rectangle
+// or lasso outline.
+
+void IslaCanvas::DrawEditOutline(wxDC &dc)
+{
+  if (edpoly.size() < 2) return;
+  wxPen pen(*wxBLACK, 2, wxSHORT_DASH);
+  dc.SetLogicalFunction(wxINVERT);
+  dc.SetPen(pen);
+  dc.SetBrush(*wxTRANSPARENT_BRUSH);
+  if (edtool == EDIT_RECT) {
+    int l = min(edpoly[0].x, edpoly[1].x), t = min(edpoly[0].y, edpoly[1].y);
+    int w = abs(edpoly[1].x - edpoly[0].x);
+    int h = abs(edpoly[1].y - edpoly[0].y);
+    dc.DrawRectangle(l, t, w, h);
+  } else
+    dc.DrawLines(edpoly.size(), &edpoly[0]);
+}
+
+
+// Apply a region edit: one batched model update, then a repaint of
+// the cells of the edited landmasses and of the island layer
+// (islands may have been merged, split or reclassified anywhere
+// along the edited landmasses).
+
+void IslaCanvas::ApplyRegionEdit(const GridData<bool> &sel, bool val)
+{
+  {
+    lock_guard<shared_mutex> lock(tiles->modelLock());
+    if (model->setMaskRegion(sel, val) == 0) return;
+  }
+  RefreshChanged();
+  Invalidate(LAYER_ISLANDS);
+}
+
+
+// Undo or redo the last mask edit.  A whole single-cell edit stroke
+// is undone at once, so any motion still queued for it is applied
+// first.
+
+void IslaCanvas::UndoEdit(bool redo)
+{
+  FlushMotion();
+  {
+    lock_guard<shared_mutex> lock(tiles->modelLock());
+    if (!(redo ? model->redo() : model->undo())) return;
+  }
+  RefreshChanged();
+  Invalidate(LAYER_ISLANDS);
+}
+
+
+// Motion coalescing.  Pan offsets and edit stroke samples from mouse
+// events are accumulated and applied together at most once per
+// display frame, so fast pointer motion gives one model update and
+// one repaint per frame rather than one per event.
+
+void IslaCanvas::QueuePan(int dx, int dy)
+{
+  pandx += dx;  pandy += dy;
+  ScheduleMotion();
+}
+
+void IslaCanvas::ScheduleMotion(void)
+{
+  if (!motionTimer.IsRunning())
+    motionTimer.Start(FRAME_MS, wxTIMER_ONE_SHOT);
+}
+
+void IslaCanvas::FlushMotion(void)
+{
+  motionTimer.Stop();
+  if (pandx != 0 || pandy != 0) {
+    int dx = pandx, dy = pandy;
+    pandx = pandy = 0;
+    Pan(dx, dy);
+  }
+  if (!edsamples.empty()) ApplyStroke();
+}
+
+
+// Cells on a line between two grid cells (Bresenham), excluding the
+// starting cell.  Columns are "unwrapped", i.e. may fall outside the
+// grid.
+
+static void cellLine(int c0, int r0, int c1, int r1,
+                     vector<pair<int, int> > &cells)
+{
+  int dc = abs(c1 - c0), dr = -abs(r1 - r0);
+  int sc = c0 < c1 ? 1 : -1, sr = r0 < r1 ? 1 : -1;
+  int err = dc + dr;
+  while (c0 != c1 || r0 != r1) {
+    int e2 = 2 * err;
+    if (e2 >= dr) { err += dr;  c0 += sc; }
+    if (e2 <= dc) { err += dc;  r0 += sr; }
+    cells.push_back(make_pair(c0, r0));
+  }
+}
+
+
+// Apply the edit stroke samples accumulated since the last flush:
+// join them with straight lines of cells (taking the short way round
+// in longitude) so that fast drags don't skip cells, set all the
+// cells on the lines in one go, then redraw the bounding block.
+
+void IslaCanvas::ApplyStroke(void)
+{
+  int nlon = model->grid()->nlon();
+  vector<pair<int, int> > cells;
+  int uc = edcol, r = edrow;
+  for (vector<pair<int, int> >::const_iterator it = edsamples.begin();
+       it != edsamples.end(); ++it) {
+    int dc = it->first - (uc % nlon + nlon) % nlon;
+    if (dc > nlon / 2) dc -= nlon;
+    if (dc < -nlon / 2) dc += nlon;
+    cellLine(uc, r, uc + dc, it->second, cells);
+    uc += dc;  r = it->second;
+  }
+  edsamples.clear();
+  if (cells.empty()) return;
+
+  int cmin = edcol, cmax = edcol, rmin = edrow, rmax = edrow;
+  lock_guard<shared_mutex> lock(tiles->modelLock());
+  for (vector<pair<int, int> >::const_iterator it = cells.begin();
+       it != cells.end(); ++it) {
+    model->setMask(it->second, (it->first % nlon + nlon) % nlon, edval);
+    cmin = min(cmin, it->first);  cmax = max(cmax, it->first);
+    rmin = min(rmin, it->second);  rmax = max(rmax, it->second);
+  }
+  edcol = (uc % nlon + nlon) % nlon;  edrow = r;
+  RefreshCellSpan(rmin, rmax, cmin, cmax);
 }
 
 
@@ -555,6 +1233,7 @@ void IslaCanvas::OnContextMenu(wxContextMenuEvent &event)
 
 void IslaCanvas::OnContextMenuEvent(wxCommandEvent &event)
 {
+  lock_guard<shared_mutex> lock(tiles->modelLock());
   switch (event.GetId()) {
   case ID_CTX_TOGGLE_ISLAND:
     model->setIsIsland(popup_row, popup_col,
@@ -570,7 +1249,9 @@ void IslaCanvas::OnContextMenuEvent(wxCommandEvent &event)
     model->resetIsland(popup_row, popup_col);
     break;
   }
-  Refresh();
+  tiles->clear();
+  Invalidate(LAYER_CELLS);
+  Invalidate(LAYER_ISLANDS);
 }
 
 
@@ -710,6 +1391,14 @@ int IslaCanvas::latToRow(double lat)
 }
 
 
+// Timer for coalesced mouse motion.
+
+void IslaCanvas::OnMotionTimer(wxTimerEvent &WXUNUSED(event))
+{
+  FlushMotion();
+}
+
+
 // Pan handler.
 
 void IslaCanvas::Pan(int dx, int dy)
@@ -723,7 +1412,10 @@ void IslaCanvas::Pan(int dx, int dy)
   clat = min(clat, iclats[iclats.size()-1] - halfh);
   if (fabs(clat - clatb) * scale < 1) clat = clatb;
   SetupAxes(dx != 0, dy != 0);
-  Refresh();
+  double sy = (clat - clatb) * scale;
+  int isy = static_cast<int>(floor(sy + 0.5));
+  ScrollLayers(dx, isy, fabs(sy - isy) < 1.0E-6);
+  Invalidate(LAYER_AXES);
 }
 
 
@@ -830,4 +1522,7 @@ void IslaCanvas::SizeRecalc(void)
   clat = max(clat, iclats[0] + halfh);
   clat = min(clat, iclats[iclats.size()-1] - halfh);
   SetupAxes();
+  UpdateTileView();
+  dirty = (1 << NLAYERS) - 1;
+  stale = dirty;
 }
@@ -14,6 +14,9 @@
 #include "wx/wx.h"
 
 #include "IslaModel.hh"
+#include "TileCache.hh"
+#include "OutlineIndex.hh"
+#include "RenderStats.hh"
 class IslaFrame;
 
 // Note that in IslaCanvas, all cell coordinates are
@@ -22,7 +25,7 @@ class IslaFrame;
 class IslaCanvas: public wxWindow {
 public:
   IslaCanvas(wxWindow *parent, IslaModel *m);
-  virtual ~IslaCanvas() { delete popup; }
+  virtual ~IslaCanvas() { delete tiles;  delete popup; }
 
   // Pan and zoom behaviour.
   void Pan(int dx, int dy);
@@ -49,11 +52,21 @@ public:
     panning = zoom_selection = edit = false;
     SetCursor(wxCursor(wxCURSOR_ARROW));
   }
-  void SetEdit() {
+  // Mask edit tools: toggle single cells, or set all cells in a
+  // rectangle, lasso polygon or connected region at once.
+  enum EditTool { EDIT_CELL, EDIT_RECT, EDIT_LASSO, EDIT_FILL };
+  void SetEdit(EditTool tool = EDIT_CELL) {
     panning = zoom_selection = false;
     edit = true;
-    SetCursor(wxCursor(wxCURSOR_PENCIL));
+    edtool = tool;
+    SetCursor(wxCursor(tool == EDIT_CELL ? wxCURSOR_PENCIL :
+                       (tool == EDIT_FILL ? wxCURSOR_PAINT_BRUSH :
+                        wxCURSOR_CROSS)));
   }
+  EditTool GetEditTool(void) const { return edtool; }
+
+  // Undo or redo mask edits.
+  void UndoEdit(bool redo = false);
   void SetShowIslands(bool show) { show_islands = show; }
   void SetShowComparison(bool show) { show_comparison = show; }
   void SetFrame(IslaFrame *f) { frame = f; }
@@ -62,8 +75,29 @@ public:
   void loadComparisonIslands(wxString fname);
   void clearComparisonIslands(void) {
     compisles.clear();
-    Refresh();
+    Invalidate(LAYER_COMPARISON);
+  }
+  const std::vector<IslaModel::IslandInfo> &comparisonIslands(void) const {
+    return compisles;
+  }
+  void setComparisonIslands(const std::vector<IslaModel::IslandInfo> &c) {
+    compisles = c;
+    Invalidate(LAYER_COMPARISON);
+  }
+
+  // Rendering layers.  Each layer is cached as a bitmap and only
+  // redrawn when invalidated; map layers are scrolled when panning.
+  enum Layer { LAYER_CELLS, LAYER_GRID, LAYER_ISLANDS, LAYER_COMPARISON,
+               LAYER_AXES, NLAYERS };
+  void Invalidate(int layer) {
+    dirty |= 1 << layer;  stale |= 1 << layer;  Refresh();
   }
+  void InvalidateAll(void);
+
+  // Grid cells are rendered into tiles on background threads.  Any
+  // change to the model must be made holding this lock exclusively.
+  std::shared_mutex &ModelLock(void) { return tiles->modelLock(); }
+  void TileReady(TileCache::Key k);
 
   // View management
   double GetScale(void) const { return scale; }
@@ -76,8 +110,12 @@ public:
   bool regionOverlay;           // Display region information?
   bool ismaskOverlay;           // Display ISMASK information?
   bool isIslandOverlay;         // Display "is island?" information?
+  bool perfOverlay;             // Display rendering performance?
 #endif
 
+  // Rendering timing and work counts.
+  RenderStats &Stats(void) { return stats; }
+
   void OnPaint(wxPaintEvent &e);
   void OnMouse(wxMouseEvent &e);
   void OnSize(wxSizeEvent &e);
@@ -103,6 +141,17 @@ private:
   void ProcessPan(wxMouseEvent &event, bool xpan, bool ypan);
   void ProcessZoomSelection(wxMouseEvent &event);
   void ProcessEdit(wxMouseEvent &event);
+  void ProcessRegionEdit(wxMouseEvent &event);
+  void DrawEditOutline(wxDC &dc);
+  void ApplyRegionEdit(const GridData<bool> &sel, bool val);
+
+  // Coalesced handling of mouse motion for panning and editing.
+  static const int FRAME_MS = 16;
+  void QueuePan(int dx, int dy);
+  void ScheduleMotion(void);
+  void FlushMotion(void);
+  void ApplyStroke(void);
+  void OnMotionTimer(wxTimerEvent &e);
 
   // Axis position and label calculation.
   void SetupAxes(bool dox = true, bool doy = true);
@@ -112,6 +161,11 @@ private:
     return std::min(minDlon * scale, minDlat * scale);
   }
 
+  // Mask pyramid level used for rendering at the current scale.
+  int CellLevel(void) const {
+    return model->pyramid().levelFor(1.0 / MinCellSize());
+  }
+
   // Set minimum cell size in either direction.
   void SetMinCellSize(int cs) { scale = cs / std::min(minDlon, minDlat); }
 
@@ -137,9 +191,34 @@ private:
   int lonToCol(double lon);
   int latToRow(double lat);
 
-  // Draw an island.
-  void drawIsland(wxDC &dc, wxPen &p, wxBrush &vb, wxBrush &hb,
-                  const IslaModel::IslandInfo &isl);
+  // Cell raster rendering.
+  void UpdateTileView(void);
+  void TileOrigin(int &ox, int &oy) const;
+  void RenderCells(wxImage &img, const wxRect &rect);
+  void CountCells(const wxRect &rect);
+
+  // Layer management.
+  bool LayerVisible(int layer) const;
+  void RenderLayer(int layer, const wxRect &rect);
+  void RenderAxes(wxDC &dc);
+  void MaskLayer(int layer);
+  void UpdateLayers(void);
+  void ScrollLayers(int dx, int dy, bool exact);
+  void BlitLayer(wxDC &dc, int layer, const wxRect &rect, int ox, int oy);
+  void RefreshCells(int r0, int r1, int c0, int c1); // Repaint after edit.
+  void RefreshCellSpan(int r0, int r1, int c0, int c1);
+  void RefreshChanged(void);
+
+  // Draw island outlines, using only outline elements that
+  // intersect the area being rendered.
+  void VisibleCells(const wxRect &rect, int &c0, int &c1, int &r0, int &r1);
+  void QueryOutlines(int layer, const wxRect &rect,
+                     std::vector<const OutlineIndex::Item *> &els);
+  int drawOutlines(wxDC &dc, wxPen &p, wxBrush &vb, wxBrush &hb,
+                   const std::vector<const OutlineIndex::Item *> &els);
+#ifdef ISLA_DEBUG
+  void drawPerfOverlay(wxDC &dc);
+#endif
 
   enum MouseState {
     MOUSE_NOTHING,
@@ -147,7 +226,8 @@ private:
     MOUSE_PAN_Y,
     MOUSE_PAN_2D,
     MOUSE_ZOOM_SELECTION,
-    MOUSE_EDIT
+    MOUSE_EDIT,
+    MOUSE_EDIT_REGION
   };
 
 
@@ -177,6 +257,11 @@ private:
   bool edit;                    // Are we in edit mode?
   int edcol, edrow;             // Edit coordinates.
   bool edval;                   // Value for drag edits.
+  EditTool edtool;              // Current edit tool.
+  std::vector<wxPoint> edpoly;  // Region edit outline points.
+  std::vector<std::pair<int, int> > edsamples;
+                                // Pending edit stroke samples
+                                // (column, row).
 
   // Display parameters.
   bool show_islands;
@@ -201,9 +286,29 @@ private:
                                 // borders, calculated as the text
                                 // extent for the string "888".
 
+  // Rendering statistics.
+  RenderStats stats;
+
+  // Cell tile renderer and cache.
+  TileCache *tiles;
+
+  // Cached layer bitmaps and invalid layer flags.
+  wxBitmap layers[NLAYERS];
+  unsigned int dirty;
+
   // Comparison island information.
   std::vector<IslaModel::IslandInfo> compisles;
 
+  // Outline indexes for the island and comparison layers, and flags
+  // for layers whose islands have changed since their index was
+  // built.
+  OutlineIndex islindex, compindex;
+  unsigned int stale;
+
+  // Timer and pending pan offsets for coalesced mouse motion.
+  wxTimer motionTimer;
+  int pandx, pandy;
+
   // Current axis label positions and text.
   std::vector<int> laxpos;  std::vector<wxString> laxlab;
   std::vector<int> raxpos;  std::vector<wxString> raxlab;
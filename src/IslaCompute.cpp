@@ -222,7 +222,7 @@ void IslaCompute::boundRows(LMass lm, Seg &rs)
   int segid = 0, nx = glm.nlon();
   set<int> last, cur;
   for (int ib = 0; ib < (bbox.both ? 2 : 1); ++ib) {
-    wxRect &box = ib == 0 ? bbox.b1 : bbox.b2;
+    Rect &box = ib == 0 ? bbox.b1 : bbox.b2;
     for (int y = 0; y < box.height; ++y) {
       vector<int> xs;
       for (int x = 0; x < box.width; ++x)
@@ -258,7 +258,7 @@ void IslaCompute::boundCols(LMass lm, Seg &cs)
   int segid = 0;
   set<int> last, cur;
   for (int ib = 0; ib < (bbox.both ? 2 : 1); ++ib) {
-    wxRect &box = ib == 0 ? bbox.b1 : bbox.b2;
+    Rect &box = ib == 0 ? bbox.b1 : bbox.b2;
     for (int x = 0; x < box.width; ++x) {
       vector<int> ys;
       for (int y = 0; y < box.height; ++y)
@@ -12,13 +12,13 @@
 #include <vector>
 #include <set>
 #include <map>
-#include <wx/gdicmn.h>
+#include "Rect.hh"
 #include "GridData.hh"
 #include "IslaModel.hh"
 
 class IslaCompute {
 public:
-  typedef wxRect Box;
+  typedef Rect Box;
   typedef int Score;
   typedef int BoxID;
   struct BoxInfo {
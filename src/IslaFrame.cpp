@@ -7,6 +7,7 @@
 //----------------------------------------------------------------------
 
 #include <string>
+#include <mutex>
 using namespace std;
 
 #include "wx/wx.h"
@@ -25,6 +26,8 @@ using namespace std;
 #include "ids.hh"
 
 #include "GridData.hh"
+#include "UMFile.hh"
+#include "SessionFile.hh"
 using namespace netCDF;
 
 
@@ -66,6 +69,13 @@ BEGIN_EVENT_TABLE(IslaFrame, wxFrame)
 
   EVT_MENU  (ID_SELECT,             IslaFrame::OnMenu)
   EVT_MENU  (ID_EDIT_MASK,          IslaFrame::OnMenu)
+  EVT_MENU  (ID_EDIT_RECT,          IslaFrame::OnMenu)
+  EVT_MENU  (ID_EDIT_LASSO,         IslaFrame::OnMenu)
+  EVT_MENU  (ID_EDIT_FILL,          IslaFrame::OnMenu)
+  EVT_MENU  (wxID_UNDO,              IslaFrame::OnMenu)
+  EVT_MENU  (wxID_REDO,              IslaFrame::OnMenu)
+  EVT_UPDATE_UI (wxID_UNDO,          IslaFrame::OnUpdateUndo)
+  EVT_UPDATE_UI (wxID_REDO,          IslaFrame::OnUpdateUndo)
 
   EVT_MENU  (wxID_HELP_CONTENTS,    IslaFrame::OnMenu)
   EVT_MENU  (wxID_ABOUT,            IslaFrame::OnMenu)
@@ -76,6 +86,8 @@ BEGIN_EVENT_TABLE(IslaFrame, wxFrame)
   EVT_MENU  (ID_DEBUG_REGION_OVERLAY,   IslaFrame::OnDebug)
   EVT_MENU  (ID_DEBUG_ISMASK_OVERLAY,   IslaFrame::OnDebug)
   EVT_MENU  (ID_DEBUG_ISISLAND_OVERLAY, IslaFrame::OnDebug)
+  EVT_MENU  (ID_DEBUG_PERF_OVERLAY,     IslaFrame::OnDebug)
+  EVT_MENU  (ID_DEBUG_FRAME_TRACE,      IslaFrame::OnDebug)
 #endif
 END_EVENT_TABLE()
 
@@ -134,6 +146,20 @@ IslaFrame::IslaFrame() :
   menuTools->AppendCheckItem(ID_EDIT_MASK, _("&Edit land/sea mask"),
                              _("Edit land/sea mask by "
                                "toggling state of cells"));
+  menuTools->AppendCheckItem(ID_EDIT_RECT, _("Edit &rectangle"),
+                             _("Toggle land/sea mask state of all "
+                               "cells in a rectangle"));
+  menuTools->AppendCheckItem(ID_EDIT_LASSO, _("Edit &lasso"),
+                             _("Toggle land/sea mask state of all "
+                               "cells inside a freehand outline"));
+  menuTools->AppendCheckItem(ID_EDIT_FILL, _("Edit &fill"),
+                             _("Fill an ocean basin or delete "
+                               "a landmass"));
+  menuTools->AppendSeparator();
+  menuTools->Append(wxID_UNDO, _("&Undo edit\tCtrl-Z"),
+                    _("Undo last land/sea mask edit"));
+  menuTools->Append(wxID_REDO, _("Re&do edit\tCtrl-Y"),
+                    _("Redo last undone land/sea mask edit"));
 #endif
 
   menuHelp->Append(wxID_HELP_CONTENTS, _("&Contents\tCtrl-H"),
@@ -159,6 +185,10 @@ IslaFrame::IslaFrame() :
   menuDebug->AppendCheckItem(ID_DEBUG_ISISLAND_OVERLAY,
                              _("\"Is island?\" overlay"),
                              _("Toggle \"is island?\" overlay"));
+  menuDebug->AppendCheckItem(ID_DEBUG_PERF_OVERLAY, _("Performance overlay"),
+                             _("Toggle rendering performance overlay"));
+  menuDebug->AppendCheckItem(ID_DEBUG_FRAME_TRACE, _("Frame trace..."),
+                             _("Write rendering frame trace to a file"));
   menuBar->Append(menuDebug, _("Debug"));
 #endif
 
@@ -230,7 +260,8 @@ IslaFrame::IslaFrame() :
     wxMessageBox(_("Failed adding book share/isla/isla.htb"));
 
   // Model.
-  model = new IslaModel();
+  IslaPreferences *prefs = IslaPreferences::get();
+  model = new IslaModel(prefs->getGrid(), prefs->getIslandThreshold());
 
   // We use two different panels to reduce flicker in wxGTK, because
   // some widgets (like wxStaticText) don't have their own X11 window,
@@ -282,8 +313,14 @@ void IslaFrame::UpdateUI()
   toolBar->ToggleTool(ID_PAN, canvas->Panning());
   menuView->Check(ID_PAN, canvas->Panning());
 #ifdef ISLA_EDIT
-  toolBar->ToggleTool(ID_EDIT_MASK, canvas->Editing());
-  menuTools->Check(ID_EDIT_MASK, canvas->Editing());
+  IslaCanvas::EditTool tool = canvas->GetEditTool();
+  bool editing = canvas->Editing();
+  toolBar->ToggleTool(ID_EDIT_MASK,
+                      editing && tool == IslaCanvas::EDIT_CELL);
+  menuTools->Check(ID_EDIT_MASK, editing && tool == IslaCanvas::EDIT_CELL);
+  menuTools->Check(ID_EDIT_RECT, editing && tool == IslaCanvas::EDIT_RECT);
+  menuTools->Check(ID_EDIT_LASSO, editing && tool == IslaCanvas::EDIT_LASSO);
+  menuTools->Check(ID_EDIT_FILL, editing && tool == IslaCanvas::EDIT_FILL);
   toolBar->ToggleTool(ID_SELECT, !canvas->Editing());
   menuTools->Check(ID_SELECT, !canvas->Editing());
 #endif
@@ -316,14 +353,34 @@ void IslaFrame::SetLocation(double lon, double lat, int x, int y)
 void IslaFrame::OnMenu(wxCommandEvent &e)
 {
   switch (e.GetId()) {
-  case wxID_NEW: model->reset();  canvas->ModelReset(model);  break;
+  case wxID_NEW: {
+    lock_guard<shared_mutex> lock(canvas->ModelLock());
+    model->reset();
+    canvas->ModelReset(model);
+    break;
+  }
   case wxID_HELP_CONTENTS: helpCtrl->Display(_("Test HELPFILE"));  break;
   case wxID_ABOUT: { IslaAboutDialogue d(this);  d.ShowModal();  break; }
   case ID_SELECT: canvas->SetSelect();  UpdateUI(); break;
   case ID_EDIT_MASK: canvas->SetEdit(); UpdateUI(); break;
+  case ID_EDIT_RECT:
+    canvas->SetEdit(IslaCanvas::EDIT_RECT);  UpdateUI();  break;
+  case ID_EDIT_LASSO:
+    canvas->SetEdit(IslaCanvas::EDIT_LASSO);  UpdateUI();  break;
+  case ID_EDIT_FILL:
+    canvas->SetEdit(IslaCanvas::EDIT_FILL);  UpdateUI();  break;
+  case wxID_UNDO: canvas->UndoEdit();      break;
+  case wxID_REDO: canvas->UndoEdit(true);  break;
   }
 }
 
+// Undo and redo are only available when there is something to undo
+// or redo.
+void IslaFrame::OnUpdateUndo(wxUpdateUIEvent &e)
+{
+  e.Enable(e.GetId() == wxID_UNDO ? model->canUndo() : model->canRedo());
+}
+
 // Debug stuff
 #ifdef ISLA_DEBUG
 void IslaFrame::OnDebug(wxCommandEvent &e)
@@ -345,6 +402,30 @@ void IslaFrame::OnDebug(wxCommandEvent &e)
     canvas->isIslandOverlay = !canvas->isIslandOverlay;
     canvas->Refresh();
     break;
+  case ID_DEBUG_PERF_OVERLAY:
+    canvas->perfOverlay = !canvas->perfOverlay;
+    canvas->Refresh();
+    break;
+  case ID_DEBUG_FRAME_TRACE: {
+    RenderStats &stats = canvas->Stats();
+    if (stats.tracing()) { stats.stopTrace();  break; }
+    wxFileDialog filedlg(this,
+                         _("Choose a file for frame trace"),
+                         wxEmptyString,
+                         _("frames.csv"),
+                         _("CSV files (*.csv)|*.csv|All files (*.*)|*.*"),
+                         wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    bool ok = filedlg.ShowModal() != wxID_CANCEL;
+    if (ok && !stats.startTrace(string(filedlg.GetPath().char_str()))) {
+      wxMessageDialog msg(this, _("Failed to open frame trace file"),
+                          _("Frame trace"), wxICON_ERROR);
+      msg.ShowModal();
+      ok = false;
+    }
+    if (!ok) { GetMenuBar()->Check(ID_DEBUG_FRAME_TRACE, false);  break; }
+    canvas->Refresh();
+    break;
+  }
   }
 }
 #endif
@@ -374,7 +455,12 @@ void IslaFrame::OnPreferences(wxCommandEvent &e)
     p->setGridColour(d.gridColour());
     p->setIslandOutlineColour(d.islandOutlineColour());
     p->setCompOutlineColour(d.compOutlineColour());
-    canvas->Refresh();
+    {
+      lock_guard<shared_mutex> lock(canvas->ModelLock());
+      model->setGridType(d.grid());
+      model->setIslandThreshold(d.islandThreshold());
+    }
+    canvas->InvalidateAll();
   }
 }
 
@@ -392,23 +478,61 @@ void IslaFrame::OnLoadMask(wxCommandEvent &WXUNUSED(e))
                        _("Choose a file to open"),
                        wxEmptyString,
                        wxEmptyString,
-                       _("NetCDF files (*.nc)|*.nc|All files (*.*)|*.*"),
+                       _("NetCDF files (*.nc)|*.nc|"
+                         "UM ancillary files (*.anc)|*.anc|"
+                         "Isla sessions (*.isls)|*.isls|"
+                         "All files (*.*)|*.*"),
                        wxFD_OPEN | wxFD_FILE_MUST_EXIST);
 
   if (filedlg.ShowModal() == wxID_CANCEL) return;
 
   string nc_file(filedlg.GetPath().char_str());
+  if (SessionFile::isSessionFile(nc_file)) {
+    try {
+      vector<IslaModel::IslandInfo> comp;
+      {
+        lock_guard<shared_mutex> lock(canvas->ModelLock());
+        model->loadSession(nc_file, comp);
+        canvas->ModelReset(model);
+      }
+      canvas->setComparisonIslands(comp);
+    } catch (std::exception &e) {
+      wxString excmsg = wxString::FromAscii(e.what());
+      wxMessageDialog msg(this,
+                          _("Failed to read session file\n\n") +
+                          excmsg, _("Session file error"), wxICON_ERROR);
+      msg.ShowModal();
+    }
+    return;
+  }
+  if (UMFile::isUMFile(nc_file)) {
+    try {
+      lock_guard<shared_mutex> lock(canvas->ModelLock());
+      model->loadUMMask(nc_file);
+      canvas->ModelReset(model);
+    } catch (std::exception &e) {
+      wxString excmsg = wxString::FromAscii(e.what());
+      wxMessageDialog msg(this,
+                          _("Failed to read mask data from UM file\n\n") +
+                          excmsg, _("UM file error"), wxICON_ERROR);
+      msg.ShowModal();
+    }
+    return;
+  }
   NcFile *nc = 0;
   string maskvar = "";
   try {
     nc = new NcFile(nc_file, NcFile::read);
     multimap<string, NcVar> vars = nc->getVars();
     wxArrayString choices;
-    for (multimap<string, NcVar>::const_iterator it = vars.begin();
-         it != vars.end(); ++it)
-      if (it->first != "lat" && it->first != "latitude" &&
-          it->first != "lon" && it->first != "longitude")
-        choices.Add(wxString::From8BitData(it->first.c_str()));
+    if (IslaModel::hasDerived(*nc))
+      choices.Add(wxT("mask"));
+    else
+      for (multimap<string, NcVar>::const_iterator it = vars.begin();
+           it != vars.end(); ++it)
+        if (it->first != "lat" && it->first != "latitude" &&
+            it->first != "lon" && it->first != "longitude")
+          choices.Add(wxString::From8BitData(it->first.c_str()));
     if (choices.GetCount() > 1) {
       wxSingleChoiceDialog choice(this, _("Select NetCDF variable"),
                                   _("NetCDF mask variable selection"),
@@ -425,6 +549,7 @@ void IslaFrame::OnLoadMask(wxCommandEvent &WXUNUSED(e))
   }
   if (maskvar != "") {
     try {
+      lock_guard<shared_mutex> lock(canvas->ModelLock());
       model->loadMask(nc_file, maskvar);
       canvas->ModelReset(model);
     } catch (std::exception &e) {
@@ -445,13 +570,24 @@ void IslaFrame::OnSaveMask(wxCommandEvent &WXUNUSED(e))
                        _("Choose a file to save to"),
                        wxEmptyString,
                        wxEmptyString,
-                       _("NetCDF files (*.nc)|*.nc|All files (*.*)|*.*"),
+                       _("NetCDF files (*.nc)|*.nc|"
+                         "Compressed NetCDF-4 with islands (*.nc)|*.nc|"
+                         "Isla sessions (*.isls)|*.isls|"
+                         "All files (*.*)|*.*"),
                        wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
 
   if (filedlg.ShowModal() == wxID_CANCEL) return;
 
+  // The compressed format also carries the derived fields and island
+  // segmentations, so reloading it needs no recalculation.  Session
+  // files hold the original mask and comparison islands too.
   try {
-    model->saveMask(string(filedlg.GetPath().char_str()));
+    string fname(filedlg.GetPath().char_str());
+    bool full = filedlg.GetFilterIndex() == 1;
+    if (filedlg.GetFilterIndex() == 2)
+      model->saveSession(fname, canvas->comparisonIslands());
+    else
+      model->saveMask(fname, full, full);
   } catch (std::exception &e) {
     wxString excmsg = wxString::FromAscii(e.what());
     wxMessageDialog msg(this, _("Failed to write NetCDF file\n\n") + excmsg,
@@ -466,13 +602,24 @@ void IslaFrame::OnExportIslands(wxCommandEvent &WXUNUSED(e))
                        _("Choose a file to export to"),
                        wxEmptyString,
                        wxEmptyString,
-                       _("Island files (*.isl)|*.isl|All files (*.*)|*.*"),
+                       _("Island files (*.isl)|*.isl|"
+                         "Binary island files (*.islb)|*.islb|"
+                         "UM ocean dumps (*.dat)|*.dat|"
+                         "All files (*.*)|*.*"),
                        wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
 
   if (filedlg.ShowModal() == wxID_CANCEL) return;
 
+  // Choosing an existing UM ocean dump updates its island data in
+  // place; anything else gets an ASCII or binary island file.
   try {
-    model->saveIslands(filedlg.GetPath());
+    string fname(filedlg.GetPath().char_str());
+    if (UMFile::isUMFile(fname))
+      model->saveIslandsToDump(fname);
+    else if (filedlg.GetFilterIndex() == 1)
+      model->saveIslands(fname, IslandWriter::BINARY);
+    else
+      model->saveIslands(fname);
   } catch (std::exception &e) {
     wxString excmsg = wxString::FromAscii(e.what());
     wxMessageDialog msg(this, _("Failed to write island file\n\n") + excmsg,
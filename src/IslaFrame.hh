@@ -37,6 +37,7 @@ private:
   void OnExit(wxCommandEvent &e);
   void OnClose(wxCloseEvent &e) { Destroy(); }
   void OnShowChange(wxCommandEvent &e);
+  void OnUpdateUndo(wxUpdateUIEvent &e);
 #ifdef ISLA_DEBUG
   void OnDebug(wxCommandEvent &e);
 #endif
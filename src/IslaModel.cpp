@@ -7,21 +7,28 @@
 //----------------------------------------------------------------------
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <stack>
+#include <algorithm>
 #include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
 using namespace std;
 
-#include <wx/ffile.h>
-#include <wx/textfile.h>
-#include <wx/tokenzr.h>
-
 #include "ncFile.h"
+#include "ncVar.h"
 using namespace netCDF;
 
 #include "IslaModel.hh"
 #include "IslaCompute.hh"
-#include "IslaPreferences.hh"
+#include "UMFile.hh"
+#include "MappedFile.hh"
+#include "SessionFile.hh"
 
 const double HadGEM2_lats[] = {
   -90, -89, -88, -87, -86, -85, -84, -83, -82, -81, -80, -79, -78, -77,
@@ -82,25 +89,42 @@ GridPtr IslaModel::makeGrid(GridType g)
   return GridPtr(newgr);
 }
 
-// Create a default model: HadCM3 grid, no land.
+const char *IslaModel::gridName(GridType g)
+{
+  switch (g) {
+  case HadCM3L: return "HadCM3L";
+  case HadCM3:  return "HadCM3";
+  case HadGEM2: return "HadGEM2";
+  }
+  return "";
+}
+
+// Create a default model: given grid, no land.
 
-IslaModel::IslaModel() :
-  gr(makeGrid(IslaPreferences::get()->getGrid())),
+IslaModel::IslaModel(GridType g, double thr) :
+  gridtype(g),
+  island_threshold(thr),
+  gr(makeGrid(g)),
   orig_mask(gr, false),
   mask(orig_mask),              // Unchanged from "original".
   grid_changes(0),
   landmass(gr, 0),              // All ocean.
   nlandmass(0),
   is_island(gr, false),         // All ocean.
-  ismask(gr, 0)                 // All ocean.
-{ }
+  ismask(gr, 0),                // All ocean.
+  edited(gr, false),
+  edits_pending(false)
+{
+  pyr.build(mask, is_island);
+  rowruns.build(mask, is_island);
+}
 
 
 // Reset to original empty mask.
 
 void IslaModel::reset(void)
 {
-  *this = IslaModel();
+  *this = IslaModel(gridtype, island_threshold);
 }
 
 
@@ -111,24 +135,175 @@ void IslaModel::loadMask(std::string file, std::string var)
   NcFile nc(file, NcFile::read);
   GridPtr newgr = GridPtr(new Grid(nc));
   GridData<bool> new_mask(newgr, nc, var);
+  setupMask(new_mask);
+  bool loaded = false;
+  if (var == "mask" && hasDerived(nc)) {
+    try { loaded = loadDerived(nc); }
+    catch (std::exception &) { loaded = false; }
+  }
+  if (!loaded) recalcAll();
   maskfile = file;
   maskvar = var;
+}
+
+
+// Load a new mask from a UM file.  The grid comes from the field's
+// lookup header (regular grids only) and the mask values are read
+// straight from the mapped field data, flipping rows and columns as
+// needed to give increasing latitudes and longitudes.
+
+void IslaModel::loadUMMask(std::string file)
+{
+  loadMask(readUMMask(file));
+  maskfile = file;
+  maskvar = "";
+}
+
+GridData<bool> IslaModel::readUMMask(std::string file)
+{
+  const int LSM_STASH = 30;
+  UMFile um(file);
+  int f = um.findField(LSM_STASH);
+  if (f == 0 && um.nfields() == 1) f = 1;
+  if (f == 0)
+    throw runtime_error("No land/sea mask field in UM file: " + file);
+  if (um.lookup(f, UMFile::LB_LBPACK) % 10 != 0)
+    throw runtime_error("Packed UM fields are not supported: " + file);
+  int nlat = um.lookup(f, UMFile::LB_LBROW);
+  int nlon = um.lookup(f, UMFile::LB_LBNPT);
+  double bzy = um.lookupReal(f, UMFile::LB_BZY);
+  double bdy = um.lookupReal(f, UMFile::LB_BDY);
+  double bzx = um.lookupReal(f, UMFile::LB_BZX);
+  double bdx = um.lookupReal(f, UMFile::LB_BDX);
+  if (nlat < 2 || nlon < 2 || bdy == 0.0 || bdx == 0.0 ||
+      fabs(bdy) > 180.0 || fabs(bdx) > 360.0)
+    throw runtime_error("Unsupported grid for UM mask field: " + file);
+  size_t start = um.fieldStart(f);
+  um.checkRange(start, static_cast<long long>(nlat) * nlon, "field data");
+
+  GridPtr newgr(new Grid(nlat, bzy + bdy, bdy, nlon, bzx + bdx, bdx));
+  GridData<bool> new_mask(newgr, false);
+  bool real = um.lookup(f, UMFile::LB_LBUSER1) == 1;
+  for (int r = 0; r < nlat; ++r) {
+    int sr = newgr->lats_reversed() ? nlat - 1 - r : r;
+    for (int c = 0; c < nlon; ++c) {
+      int sc = newgr->lons_reversed() ? nlon - 1 - c : c;
+      size_t pos = start + static_cast<size_t>(sr) * nlon + sc;
+      new_mask(r, c) = real ? um.real(pos) > 0.5 : um.word(pos) != 0;
+    }
+  }
+  return new_mask;
+}
+
+
+// Find mask variable name.
+
+string IslaModel::findMaskVar(NcFile &nc)
+{
+  multimap<string, NcVar> vars = nc.getVars();
+  string maskvar = "";
+  int count = 0;
+  for (multimap<string, NcVar>::const_iterator it = vars.begin();
+       it != vars.end(); ++it)
+    if (it->first != "lat" && it->first != "latitude" &&
+        it->first != "lon" && it->first != "longitude") {
+      maskvar = it->first;
+      ++count;
+    }
+  if (count != 1 && hasDerived(nc)) return "mask";
+  if (count != 1)
+    throw runtime_error("Can't determine mask variable");
+  return maskvar;
+}
+
+bool IslaModel::hasDerived(NcFile &nc)
+{
+  return !nc.getAtt("isla_threshold").isNull() &&
+    !nc.getVar("mask").isNull();
+}
+
+
+// Load a new mask from mask data already in memory.
+
+void IslaModel::loadMask(const GridData<bool> &new_mask)
+{
+  setupMask(new_mask);
+  recalcAll();
+}
+
+void IslaModel::setupMask(const GridData<bool> &new_mask)
+{
+  GridPtr newgr = new_mask.grid();
+  maskfile = "";
+  maskvar = "";
   gr = newgr;
   orig_mask = new_mask;
   mask = orig_mask;
+  grid_changes = 0;
   is_island = GridData<bool>(newgr, false);
   landmass = GridData<LMass>(newgr, 0);
   ismask = GridData<int>(newgr, 0);
-  recalcAll();
+  journal.clear();
+  edited = GridData<bool>(newgr, false);
+  edits_pending = false;
 }
 
 
-// Load a new mask from a NetCDF file.
+// Save current mask to a NetCDF file.  Derived data is written as
+// the landmass, ismask and is_island fields, plus landmass bounding
+// boxes and island segments indexed along "landmass_id", "island" and
+// "segment" dimensions.  Global attributes record the island
+// threshold and a hash of the mask the data was derived from.
+
+static const size_t NC_CHUNK = 256;   // Chunk size for grid fields.
+static const int NC_DEFLATE = 4;      // Deflate level.
+
+static NcVar addField(NcFile &nc, string name, NcType type,
+                      const vector<NcDim> &dims, bool compressed)
+{
+  NcVar var = nc.addVar(name, type, dims);
+  if (compressed) {
+    if (dims.size() == 2) {
+      vector<size_t> chunks(2);
+      chunks[0] = min(NC_CHUNK, dims[0].getSize());
+      chunks[1] = min(NC_CHUNK, dims[1].getSize());
+      var.setChunking(NcVar::nc_CHUNKED, chunks);
+    }
+    var.setCompression(true, true, NC_DEFLATE);
+  }
+  return var;
+}
+
+// FNV-1a hash of mask values, used to check that derived data read
+// back from a file still matches the mask.
 
-void IslaModel::saveMask(std::string file)
+static string maskHash(const GridData<bool> &mask)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  const vector<bool> &d = mask.data();
+  for (vector<bool>::const_iterator it = d.begin(); it != d.end(); ++it) {
+    h ^= *it ? 1 : 0;
+    h *= 1099511628211ULL;
+  }
+  char tmp[17];
+  sprintf(tmp, "%016llx", h);
+  return tmp;
+}
+
+// Default island name for a landmass.
+
+static string landmassName(LMass lm)
+{
+  char tmp[32];
+  snprintf(tmp, sizeof(tmp), "Landmass %u", lm);
+  return tmp;
+}
+
+void IslaModel::saveMask(std::string file, bool derived, bool compressed)
 {
   // Set up NetCDF file.
-  NcFile nc(file, NcFile::replace);
+  NcFile nc(file, NcFile::replace,
+            compressed ? NcFile::nc4 : NcFile::classic);
   NcDim latdim = nc.addDim("lat", gr->nlat());
   NcVar latvar = nc.addVar("lat", NcType::nc_DOUBLE, latdim);
   latvar.putAtt("long_name", "latitude");
@@ -140,7 +315,55 @@ void IslaModel::saveMask(std::string file)
   vector<NcDim> maskdims(2);
   maskdims[0] = latdim;
   maskdims[1] = londim;
-  NcVar maskvar = nc.addVar("mask", NcType::nc_INT, maskdims);
+  NcType bytetype = compressed ? NcType::nc_BYTE : NcType::nc_INT;
+  NcType lmtype = NcType::nc_INT;
+  if (compressed)
+    lmtype = nlandmass <= numeric_limits<unsigned short>::max() ?
+      NcType::nc_USHORT : NcType::nc_UINT;
+  NcVar maskvar = addField(nc, "mask", bytetype, maskdims, compressed);
+  NcVar lmvar, ismaskvar, isislvar, bboxvar;
+  NcVar islmvar, isminvar, isabsminvar, isnsegsvar, segvar;
+  int nsegs = 0;
+  if (derived) {
+    nc.putAtt("isla_threshold", NcType::nc_DOUBLE, island_threshold);
+    nc.putAtt("isla_mask_hash", maskHash(mask));
+    lmvar = addField(nc, "landmass", lmtype, maskdims, compressed);
+    lmvar.putAtt("long_name", "landmass index");
+    ismaskvar = addField(nc, "ismask", bytetype, maskdims, compressed);
+    ismaskvar.putAtt("long_name", "UM island ISMASK");
+    isislvar = addField(nc, "is_island", bytetype, maskdims, compressed);
+    isislvar.putAtt("long_name", "island flag");
+    if (nlandmass > 0) {
+      vector<NcDim> bboxdims(2);
+      bboxdims[0] = nc.addDim("landmass_id", nlandmass);
+      bboxdims[1] = nc.addDim("bbox", 8);
+      bboxvar = addField(nc, "landmass_bbox", NcType::nc_INT,
+                         bboxdims, compressed);
+      bboxvar.putAtt("long_name", "landmass bounding boxes (x, y, "
+                     "width, height; second box zero if unused)");
+    }
+    for (map<LMass, IslandInfo>::const_iterator it = isles.begin();
+         it != isles.end(); ++it)
+      nsegs += it->second.segments.size();
+    if (!isles.empty()) {
+      vector<NcDim> isldims(1, nc.addDim("island", isles.size()));
+      islmvar = addField(nc, "island_landmass", NcType::nc_INT,
+                         isldims, compressed);
+      isminvar = addField(nc, "island_minsegs", NcType::nc_INT,
+                          isldims, compressed);
+      isabsminvar = addField(nc, "island_absminsegs", NcType::nc_INT,
+                             isldims, compressed);
+      isnsegsvar = addField(nc, "island_nsegs", NcType::nc_INT,
+                            isldims, compressed);
+      vector<NcDim> segdims(2);
+      segdims[0] = nc.addDim("segment", nsegs);
+      segdims[1] = nc.addDim("bound", 4);
+      segvar = addField(nc, "segment_bounds", NcType::nc_INT,
+                        segdims, compressed);
+      segvar.putAtt("long_name", "island segment start and end columns "
+                    "and start and end rows");
+    }
+  }
 
   // Write data.
   latvar.putVar(gr->lats().data());
@@ -148,6 +371,48 @@ void IslaModel::saveMask(std::string file)
   GridData<int> intmask(gr, 0);
   mask.process(intmask, GridData<bool>::Convert<int>());
   maskvar.putVar(intmask.data().data());
+  if (derived) {
+    landmass.process(intmask, GridData<int>::Convert<LMass>());
+    lmvar.putVar(intmask.data().data());
+    ismaskvar.putVar(ismask.data().data());
+    is_island.process(intmask, GridData<int>::Convert<bool>());
+    isislvar.putVar(intmask.data().data());
+    if (nlandmass > 0) {
+      vector<int> bboxes;
+      for (LMass lm = 1; lm <= nlandmass; ++lm) {
+        const BBox &bb = lmbbox[lm];
+        Rect b2 = bb.both ? bb.b2 : Rect();
+        bboxes.push_back(bb.b1.x);  bboxes.push_back(bb.b1.y);
+        bboxes.push_back(bb.b1.width);  bboxes.push_back(bb.b1.height);
+        bboxes.push_back(b2.x);  bboxes.push_back(b2.y);
+        bboxes.push_back(b2.width);  bboxes.push_back(b2.height);
+      }
+      bboxvar.putVar(bboxes.data());
+    }
+    if (!isles.empty()) {
+      vector<int> lms, mins, absmins, ns, segs;
+      for (map<LMass, IslandInfo>::const_iterator it = isles.begin();
+           it != isles.end(); ++it) {
+        const vector<Rect> &ss = it->second.segments;
+        lms.push_back(it->first);
+        mins.push_back(it->second.minsegs);
+        absmins.push_back(it->second.absminsegs);
+        ns.push_back(ss.size());
+        for (vector<Rect>::const_iterator sit = ss.begin();
+             sit != ss.end(); ++sit) {
+          segs.push_back(sit->x);
+          segs.push_back(sit->GetRight());
+          segs.push_back(sit->y);
+          segs.push_back(sit->GetBottom());
+        }
+      }
+      islmvar.putVar(lms.data());
+      isminvar.putVar(mins.data());
+      isabsminvar.putVar(absmins.data());
+      isnsegsvar.putVar(ns.data());
+      if (nsegs > 0) segvar.putVar(segs.data());
+    }
+  }
 
   // Record that we've saved the grid.
   orig_mask = mask;
@@ -155,6 +420,381 @@ void IslaModel::saveMask(std::string file)
 }
 
 
+// Load derived data saved by saveMask.  Everything is checked
+// against the mask in a single pass over the grid, with no flood
+// fills or island segmentation: the mask hash and threshold must
+// match, landmass labels must be numbered in order of first
+// appearance and agree between neighbouring land cells, and the
+// ISMASK, landmass extension and island flags must be the same as
+// those calculated from the mask and loaded landmasses.
+
+bool IslaModel::loadDerived(NcFile &nc)
+{
+  double thr = 0.0;
+  string hash;
+  nc.getAtt("isla_threshold").getValues(&thr);
+  NcGroupAtt hashatt = nc.getAtt("isla_mask_hash");
+  if (hashatt.isNull()) return false;
+  hashatt.getValues(hash);
+  if (thr != island_threshold || hash != maskHash(mask)) return false;
+  multimap<string, NcVar> vars = nc.getVars();
+  if (vars.find("landmass") == vars.end() ||
+      vars.find("ismask") == vars.end() ||
+      vars.find("is_island") == vars.end())
+    return false;
+  GridData<LMass> lm(gr, nc, "landmass");
+  GridData<int> ism(gr, nc, "ismask");
+  GridData<bool> isl(gr, nc, "is_island");
+
+  // Check landmass labels and calculate landmass areas.
+  int nlon = gr->nlon(), nlat = gr->nlat();
+  nlandmass = 0;
+  lmsizes.assign(1, 0.0);
+  lmcounts.assign(1, 0);
+  for (int r = 0; r < nlat; ++r)
+    for (int c = 0; c < nlon; ++c) {
+      LMass l = mask(r, c) ? lm(r, c) : 0;
+      if (mask(r, c)) {
+        if (l < 1 || l > nlandmass + 1) return false;
+        if (l == nlandmass + 1) {
+          ++nlandmass;
+          lmsizes.push_back(0.0);
+          lmcounts.push_back(0);
+        }
+        int cp1 = (c + 1) % nlon, cm1 = (c - 1 + nlon) % nlon;
+        if (mask(r, cp1) && lm(r, cp1) != l) return false;
+        if (r < nlat - 1 &&
+            ((mask(r + 1, cm1) && lm(r + 1, cm1) != l) ||
+             (mask(r + 1, c) && lm(r + 1, c) != l) ||
+             (mask(r + 1, cp1) && lm(r + 1, cp1) != l)))
+          return false;
+      }
+      landmass(r, c) = l;
+      ++lmcounts[l];
+      lmsizes[l] += gr->cellArea(r, c);
+    }
+  calcIsMask();
+  if (landmass.data() != lm.data() || ismask.data() != ism.data())
+    return false;
+  classifyLandMasses();
+  if (is_island.data() != isl.data()) return false;
+
+  // Landmass bounding boxes.
+  vector<int> bboxes(8 * nlandmass);
+  if (nlandmass > 0) {
+    NcVar bboxvar = nc.getVar("landmass_bbox");
+    if (bboxvar.isNull() || bboxvar.getDimCount() != 2 ||
+        bboxvar.getDim(0).getSize() != nlandmass ||
+        bboxvar.getDim(1).getSize() != 8)
+      return false;
+    bboxvar.getVar(bboxes.data());
+  }
+  lmbbox.clear();
+  for (LMass l = 1; l <= nlandmass; ++l) {
+    const int *b = &bboxes[8 * (l - 1)];
+    BBox bb;
+    bb.b1 = Rect(b[0], b[1], b[2], b[3]);
+    bb.b2 = Rect(b[4], b[5], b[6], b[7]);
+    bb.both = !bb.b2.IsEmpty();
+    if (bb.b1.IsEmpty()) return false;
+    lmbbox[l] = bb;
+  }
+
+  // Islands: exactly the island-sized landmasses, with non-empty
+  // segmentations.
+  size_t nisl = 0;
+  for (LMass l = 1; l <= nlandmass; ++l)
+    if (islandSized(l)) ++nisl;
+  isles.clear();
+  if (nisl == 0) return nc.getVar("island_landmass").isNull();
+  NcVar islmvar = nc.getVar("island_landmass");
+  NcVar isminvar = nc.getVar("island_minsegs");
+  NcVar isabsminvar = nc.getVar("island_absminsegs");
+  NcVar isnsegsvar = nc.getVar("island_nsegs");
+  NcVar segvar = nc.getVar("segment_bounds");
+  if (islmvar.isNull() || isminvar.isNull() || isabsminvar.isNull() ||
+      isnsegsvar.isNull() || segvar.isNull() ||
+      islmvar.getDimCount() != 1 || islmvar.getDim(0).getSize() != nisl ||
+      segvar.getDimCount() != 2 || segvar.getDim(1).getSize() != 4)
+    return false;
+  vector<int> lms(nisl), mins(nisl), absmins(nisl), ns(nisl);
+  islmvar.getVar(lms.data());
+  isminvar.getVar(mins.data());
+  isabsminvar.getVar(absmins.data());
+  isnsegsvar.getVar(ns.data());
+  size_t nsegs = 0;
+  for (size_t i = 0; i < nisl; ++i) {
+    if (lms[i] < 1 || !islandSized(lms[i]) || ns[i] < 1) return false;
+    nsegs += ns[i];
+  }
+  if (segvar.getDim(0).getSize() != nsegs) return false;
+  vector<int> segs(4 * nsegs);
+  segvar.getVar(segs.data());
+  const int *s = segs.data();
+  for (size_t i = 0; i < nisl; ++i) {
+    IslandInfo &is = isles[lms[i]];
+    is.name = landmassName(lms[i]);
+    is.minsegs = mins[i];
+    is.absminsegs = absmins[i];
+    for (int j = 0; j < ns[i]; ++j, s += 4)
+      is.segments.push_back(Rect(s[0], s[2], s[1] - s[0] + 1,
+                                 s[3] - s[2] + 1));
+    IslaCompute::coincidence(is.segments, is.vcoinc, is.hcoinc);
+  }
+  return isles.size() == nisl;
+}
+
+
+// Save the complete model state, along with a set of comparison
+// islands, to a session file.
+
+static void packIslands(uint32_t lm, const IslaModel::IslandInfo &is,
+                        vector<SessionFile::IslandRecord> &recs,
+                        vector<SessionFile::SegmentRecord> &segs,
+                        string &strings)
+{
+  SessionFile::IslandRecord rec;
+  rec.landmass = lm;
+  rec.minsegs = is.minsegs;
+  rec.absminsegs = is.absminsegs;
+  rec.nsegs = is.segments.size();
+  rec.name = strings.size();
+  rec.name_len = is.name.size();
+  strings += is.name;
+  recs.push_back(rec);
+  for (vector<Rect>::const_iterator it = is.segments.begin();
+       it != is.segments.end(); ++it) {
+    SessionFile::SegmentRecord seg;
+    seg.isis = it->x;  seg.ieis = it->GetRight();
+    seg.jsis = it->y;  seg.jeis = it->GetBottom();
+    segs.push_back(seg);
+  }
+}
+
+template<typename T> static void toBytes(const GridData<T> &in,
+                                         vector<uint8_t> &out)
+{
+  const vector<T> &d = in.data();
+  out.resize(d.size());
+  for (size_t i = 0; i < d.size(); ++i) out[i] = d[i];
+}
+
+void IslaModel::saveSession(string file, const vector<IslandInfo> &comp) const
+{
+  typedef SessionFile SF;
+  SF::Header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.gridtype = gridtype;
+  hdr.threshold = island_threshold;
+  hdr.nlat = gr->nlat();
+  hdr.nlon = gr->nlon();
+  hdr.nlandmass = nlandmass;
+  hdr.nisles = isles.size();
+  hdr.ncomp = comp.size();
+  hdr.grid_changes = grid_changes;
+  string strings;
+  hdr.maskfile = strings.size();  hdr.maskfile_len = maskfile.size();
+  strings += maskfile;
+  hdr.maskvar = strings.size();  hdr.maskvar_len = maskvar.size();
+  strings += maskvar;
+
+  // Grid fields, as bytes except for landmass indexes.
+  vector<uint8_t> om, m, ism, isl;
+  toBytes(orig_mask, om);
+  toBytes(mask, m);
+  toBytes(ismask, ism);
+  toBytes(is_island, isl);
+  vector<double> lats = gr->lats(), lons = gr->lons();
+
+  // Landmass bounding boxes.
+  vector<SF::BBoxRecord> bboxes(nlandmass);
+  for (LMass lm = 1; lm <= nlandmass; ++lm) {
+    map<LMass, BBox>::const_iterator it = lmbbox.find(lm);
+    if (it == lmbbox.end()) continue;
+    SF::BBoxRecord &rec = bboxes[lm - 1];
+    const Rect &b1 = it->second.b1, &b2 = it->second.b2;
+    rec.both = it->second.both;
+    rec.b1[0] = b1.x;  rec.b1[1] = b1.y;
+    rec.b1[2] = b1.width;  rec.b1[3] = b1.height;
+    rec.b2[0] = b2.x;  rec.b2[1] = b2.y;
+    rec.b2[2] = b2.width;  rec.b2[3] = b2.height;
+  }
+
+  // Islands and comparison islands.
+  vector<SF::IslandRecord> isrecs, comprecs;
+  vector<SF::SegmentRecord> issegs, compsegs;
+  for (map<LMass, IslandInfo>::const_iterator it = isles.begin();
+       it != isles.end(); ++it)
+    packIslands(it->first, it->second, isrecs, issegs, strings);
+  for (size_t i = 0; i < comp.size(); ++i)
+    packIslands(i, comp[i], comprecs, compsegs, strings);
+
+  const void *data[SF::NSECTIONS];
+  size_t n = om.size();
+  data[SF::LATS] = lats.data();
+  hdr.length[SF::LATS] = lats.size() * sizeof(double);
+  data[SF::LONS] = lons.data();
+  hdr.length[SF::LONS] = lons.size() * sizeof(double);
+  data[SF::ORIG_MASK] = om.data();   hdr.length[SF::ORIG_MASK] = n;
+  data[SF::MASK] = m.data();         hdr.length[SF::MASK] = n;
+  data[SF::LANDMASS] = landmass.data().data();
+  hdr.length[SF::LANDMASS] = n * sizeof(LMass);
+  data[SF::ISMASK] = ism.data();     hdr.length[SF::ISMASK] = n;
+  data[SF::IS_ISLAND] = isl.data();  hdr.length[SF::IS_ISLAND] = n;
+  data[SF::LMBBOX] = bboxes.data();
+  hdr.length[SF::LMBBOX] = bboxes.size() * sizeof(SF::BBoxRecord);
+  data[SF::LMSIZES] = lmsizes.data();
+  hdr.length[SF::LMSIZES] = lmsizes.size() * sizeof(double);
+  data[SF::LMCOUNTS] = lmcounts.data();
+  hdr.length[SF::LMCOUNTS] = lmcounts.size() * sizeof(int);
+  data[SF::ISLANDS] = isrecs.data();
+  hdr.length[SF::ISLANDS] = isrecs.size() * sizeof(SF::IslandRecord);
+  data[SF::SEGMENTS] = issegs.data();
+  hdr.length[SF::SEGMENTS] = issegs.size() * sizeof(SF::SegmentRecord);
+  data[SF::COMP_ISLANDS] = comprecs.data();
+  hdr.length[SF::COMP_ISLANDS] = comprecs.size() * sizeof(SF::IslandRecord);
+  data[SF::COMP_SEGMENTS] = compsegs.data();
+  hdr.length[SF::COMP_SEGMENTS] =
+    compsegs.size() * sizeof(SF::SegmentRecord);
+  data[SF::STRINGS] = strings.data();
+  hdr.length[SF::STRINGS] = strings.size();
+  SF::write(file, hdr, data);
+}
+
+
+// Restore model state and comparison islands from a session file.
+// Everything is read into local data first, so a bad file leaves
+// the model unchanged.
+
+static void unpackIslands(const SessionFile &sf, SessionFile::Section isec,
+                          SessionFile::Section ssec, size_t nisl,
+                          vector<pair<uint32_t, IslaModel::IslandInfo> > &out)
+{
+  const SessionFile::IslandRecord *recs =
+    sf.section<SessionFile::IslandRecord>(isec, nisl);
+  size_t nsegs = 0;
+  for (size_t i = 0; i < nisl; ++i) nsegs += recs[i].nsegs;
+  const SessionFile::SegmentRecord *segs =
+    sf.section<SessionFile::SegmentRecord>(ssec, nsegs);
+  out.resize(nisl);
+  for (size_t i = 0; i < nisl; ++i) {
+    IslaModel::IslandInfo &is = out[i].second;
+    out[i].first = recs[i].landmass;
+    is.name = sf.str(recs[i].name, recs[i].name_len);
+    is.minsegs = recs[i].minsegs;
+    is.absminsegs = recs[i].absminsegs;
+    for (uint32_t j = 0; j < recs[i].nsegs; ++j, ++segs)
+      is.segments.push_back(Rect(segs->isis, segs->jsis,
+                                 segs->ieis - segs->isis + 1,
+                                 segs->jeis - segs->jsis + 1));
+    IslaCompute::coincidence(is.segments, is.vcoinc, is.hcoinc);
+  }
+}
+
+template<typename T> static void fromBytes(const uint8_t *in,
+                                           GridData<T> &out)
+{
+  vector<T> &d = out.data();
+  for (size_t i = 0; i < d.size(); ++i) d[i] = in[i];
+}
+
+// Is a landmass bounding box from a session file one that
+// calcBBoxes could have produced?  Columns start from 2 and may run
+// past the end of the grid, wrapping round in longitude.
+
+static bool validBBox(const Rect &b, int nlat, int nlon)
+{
+  return b.x >= 0 && b.x <= nlon + 1 && b.width >= 1 && b.width <= nlon &&
+    b.y >= 0 && b.height >= 1 && b.y + b.height <= nlat;
+}
+
+void IslaModel::loadSession(string file, vector<IslandInfo> &comp)
+{
+  typedef SessionFile SF;
+  SF sf(file);
+  const SF::Header &hdr = sf.header();
+  if (hdr.gridtype > HadGEM2 || hdr.nlat < 2 || hdr.nlon < 2)
+    throw runtime_error("Corrupt session file: " + file);
+  size_t n = static_cast<size_t>(hdr.nlat) * hdr.nlon;
+  LMass nlm = hdr.nlandmass;
+
+  // Grid and grid fields.
+  const double *lt = sf.section<double>(SF::LATS, hdr.nlat);
+  const double *ln = sf.section<double>(SF::LONS, hdr.nlon);
+  GridPtr newgr(new Grid(vector<double>(lt, lt + hdr.nlat),
+                         vector<double>(ln, ln + hdr.nlon)));
+  GridData<bool> om(newgr, false), m(newgr, false), isl(newgr, false);
+  GridData<LMass> lm(newgr, 0);
+  GridData<int> ism(newgr, 0);
+  fromBytes(sf.section<uint8_t>(SF::ORIG_MASK, n), om);
+  fromBytes(sf.section<uint8_t>(SF::MASK, n), m);
+  fromBytes(sf.section<uint8_t>(SF::ISMASK, n), ism);
+  fromBytes(sf.section<uint8_t>(SF::IS_ISLAND, n), isl);
+  const LMass *lmsec = sf.section<LMass>(SF::LANDMASS, n);
+  copy(lmsec, lmsec + n, lm.data().begin());
+  for (size_t i = 0; i < n; ++i)
+    if (lm.data()[i] > nlm || ism.data()[i] > 2)
+      throw runtime_error("Corrupt session file: " + file);
+
+  // Landmass information.
+  const SF::BBoxRecord *bbrecs = sf.section<SF::BBoxRecord>(SF::LMBBOX, nlm);
+  map<LMass, BBox> bboxes;
+  for (LMass l = 1; l <= nlm; ++l) {
+    const SF::BBoxRecord &rec = bbrecs[l - 1];
+    BBox &bb = bboxes[l];
+    bb.both = rec.both;
+    bb.b1 = Rect(rec.b1[0], rec.b1[1], rec.b1[2], rec.b1[3]);
+    bb.b2 = Rect(rec.b2[0], rec.b2[1], rec.b2[2], rec.b2[3]);
+    if (!validBBox(bb.b1, hdr.nlat, hdr.nlon) ||
+        (bb.both && !validBBox(bb.b2, hdr.nlat, hdr.nlon)))
+      throw runtime_error("Corrupt session file: " + file);
+  }
+  const double *sizes = sf.section<double>(SF::LMSIZES, nlm + 1);
+  const int32_t *counts = sf.section<int32_t>(SF::LMCOUNTS, nlm + 1);
+
+  // Islands.
+  vector<pair<uint32_t, IslandInfo> > isrecs, comprecs;
+  unpackIslands(sf, SF::ISLANDS, SF::SEGMENTS, hdr.nisles, isrecs);
+  unpackIslands(sf, SF::COMP_ISLANDS, SF::COMP_SEGMENTS, hdr.ncomp,
+                comprecs);
+  map<LMass, IslandInfo> newisles;
+  for (size_t i = 0; i < isrecs.size(); ++i) {
+    if (isrecs[i].first < 1 || isrecs[i].first > nlm)
+      throw runtime_error("Corrupt session file: " + file);
+    newisles[isrecs[i].first] = isrecs[i].second;
+  }
+
+  string mf = sf.str(hdr.maskfile, hdr.maskfile_len);
+  string mv = sf.str(hdr.maskvar, hdr.maskvar_len);
+
+  // Install the new state.
+  gridtype = static_cast<GridType>(hdr.gridtype);
+  island_threshold = hdr.threshold;
+  maskfile = mf;
+  maskvar = mv;
+  gr = newgr;
+  orig_mask = om;
+  mask = m;
+  grid_changes = hdr.grid_changes;
+  landmass = lm;
+  nlandmass = nlm;
+  lmbbox = bboxes;
+  lmsizes.assign(sizes, sizes + nlm + 1);
+  lmcounts.assign(counts, counts + nlm + 1);
+  is_island = isl;
+  ismask = ism;
+  isles = newisles;
+  pyr.build(mask, is_island);
+  rowruns.build(mask, is_island);
+  journal.clear();
+  edited = GridData<bool>(newgr, false);
+  edits_pending = false;
+  comp.clear();
+  for (size_t i = 0; i < comprecs.size(); ++i)
+    comp.push_back(comprecs[i].second);
+}
+
+
 // Recalculate everything: land masses, ISMASK, islands.
 
 void IslaModel::recalcAll(void)
@@ -164,6 +804,9 @@ void IslaModel::recalcAll(void)
   calcBBoxes();
   isles.clear();
   calcIslands();
+  edited = false;
+  edits_pending = false;
+  chboxes.assign(1, Rect(0, 0, gr->nlon(), gr->nlat()));
 }
 
 
@@ -175,7 +818,8 @@ void IslaModel::setIsIsland(int cr, int cc, bool val)
   LMass lm = landmass(cr, cc);
   bool found = false, before = false;
   int nlat = gr->nlat(), nlon = gr->nlon();
-  for (int r = 0; r < nlat; ++r)
+  for (int r = 0; r < nlat; ++r) {
+    bool rowhit = false;
     for (int c = 0; c < nlon; ++c)
       if (landmass(r, c) == lm) {
         if (!found) {
@@ -184,12 +828,325 @@ void IslaModel::setIsIsland(int cr, int cc, bool val)
           found = true;
         }
         is_island(r, c) = val;
+        pyr.update(r, c, mask(r, c), val);
+        rowhit = true;
       }
+    if (rowhit) rowruns.updateRow(r, mask, is_island);
+  }
   if (before) isles.erase(lm);
   else calcIsland(lm);
 }
 
 
+// Bulk edit selections.  Rectangles are in grid cells, inclusive,
+// and wrap round in longitude if c1 < c0.
+
+void IslaModel::selectRect(int r0, int c0, int r1, int c1,
+                           GridData<bool> &sel) const
+{
+  int nlon = gr->nlon(), nlat = gr->nlat();
+  if (r0 > r1) swap(r0, r1);
+  r0 = max(0, r0);  r1 = min(nlat - 1, r1);
+  int ncols = (c1 - c0 + nlon) % nlon + 1;
+  for (int r = r0; r <= r1; ++r)
+    for (int i = 0, c = c0; i < ncols; ++i, c = (c + 1) % nlon)
+      sel(r, c) = true;
+}
+
+
+// Select cells whose centres are inside a polygon given as longitude
+// and latitude vertices (even-odd rule).  Longitudes are unwrapped
+// relative to the first vertex, so polygons may cross the date line
+// or the Greenwich meridian.
+
+void IslaModel::selectPolygon(const vector<pair<double, double> > &lonlat,
+                              GridData<bool> &sel) const
+{
+  int n = lonlat.size();
+  if (n < 3) return;
+  vector<double> lons(n), lats(n);
+  double lonmin = lonlat[0].first, lonmax = lonmin;
+  for (int i = 0; i < n; ++i) {
+    double lon = lonlat[i].first;
+    if (i > 0) {
+      double prev = lons[i - 1];
+      lon = prev + fmod(fmod(lon - prev, 360.0) + 540.0, 360.0) - 180.0;
+    }
+    lons[i] = lon;  lats[i] = lonlat[i].second;
+    lonmin = min(lonmin, lon);  lonmax = max(lonmax, lon);
+  }
+  double latmin = *min_element(lats.begin(), lats.end());
+  double latmax = *max_element(lats.begin(), lats.end());
+
+  int nlon = gr->nlon(), nlat = gr->nlat();
+  for (int r = 0; r < nlat; ++r) {
+    double lat = gr->lat(r);
+    if (lat < latmin || lat > latmax) continue;
+    for (int c = 0; c < nlon; ++c) {
+      double lon = lonmin + fmod(fmod(gr->lon(c) - lonmin, 360.0) + 360.0,
+                                 360.0);
+      if (lon > lonmax) continue;
+      bool in = false;
+      for (int i = 0, j = n - 1; i < n; j = i++)
+        if ((lats[i] > lat) != (lats[j] > lat) &&
+            lon < lons[j] + (lat - lats[j]) * (lons[i] - lons[j]) /
+            (lats[i] - lats[j]))
+          in = !in;
+      if (in) sel(r, c) = true;
+    }
+  }
+}
+
+
+// Select the connected region containing a cell: the whole landmass
+// for a land cell (connected through neighbours, including diagonal
+// neighbours, as for landmass indexing), or the whole ocean basin
+// for an ocean cell (connected only through edge neighbours, since
+// diagonally adjacent land cells block the ocean).
+
+void IslaModel::selectConnected(int r0, int c0, GridData<bool> &sel) const
+{
+  int nlon = gr->nlon(), nlat = gr->nlat();
+  bool val = mask(r0, c0);
+  GridData<bool> seen(gr, false);
+  typedef pair<int,int> Cell;
+  stack<Cell> st;
+  st.push(Cell(r0, c0));
+  seen(r0, c0) = true;
+  while (!st.empty()) {
+    Cell chk = st.top();
+    st.pop();
+    int r = chk.first, c = chk.second;
+    sel(r, c) = true;
+    for (int dr = -1; dr <= 1; ++dr)
+      for (int dc = -1; dc <= 1; ++dc) {
+        if ((dr == 0 && dc == 0) || (!val && dr != 0 && dc != 0)) continue;
+        int rr = r + dr, cc = (c + dc + nlon) % nlon;
+        if (rr < 0 || rr >= nlat || seen(rr, cc) || mask(rr, cc) != val)
+          continue;
+        seen(rr, cc) = true;
+        st.push(Cell(rr, cc));
+      }
+  }
+}
+
+
+// Apply a bulk edit.  The count of cells differing from the original
+// mask is adjusted once for the whole batch.
+
+int IslaModel::setMaskRegion(const GridData<bool> &sel, bool val)
+{
+  if (sel.grid() != gr)
+    throw domain_error("grid mismatch in IslaModel::setMaskRegion");
+  GridData<bool> changed(gr, false);
+  const vector<bool> &s = sel.data(), &orig = orig_mask.data();
+  vector<bool> &m = mask.data(), &ch = changed.data();
+  int nchanged = 0, dchanges = 0;
+  for (unsigned int i = 0; i < s.size(); ++i)
+    if (s[i] && m[i] != val) {
+      m[i] = val;
+      ch[i] = true;
+      ++nchanged;
+      dchanges += orig[i] == val ? -1 : 1;
+    }
+  if (nchanged == 0) return 0;
+  grid_changes += dchanges;
+  journal.end();
+  journal.record(changed);
+  recalcEdited(changed);
+  return nchanged;
+}
+
+
+// Undo or redo a journal entry.  Entries only record which cells
+// were flipped, so both directions flip the same cells back again.
+
+bool IslaModel::undo(void)
+{
+  const EditJournal::Delta *d = journal.undo();
+  if (!d) return false;
+  applyDelta(*d);
+  return true;
+}
+
+bool IslaModel::redo(void)
+{
+  const EditJournal::Delta *d = journal.redo();
+  if (!d) return false;
+  applyDelta(*d);
+  return true;
+}
+
+void IslaModel::applyDelta(const EditJournal::Delta &d)
+{
+  GridData<bool> changed(gr, false);
+  const vector<bool> &orig = orig_mask.data();
+  vector<bool> &m = mask.data(), &ch = changed.data();
+  for (EditJournal::Delta::const_iterator it = d.begin();
+       it != d.end(); ++it)
+    for (unsigned int i = it->start; i < it->start + it->length; ++i) {
+      m[i] = !m[i];
+      ch[i] = true;
+      grid_changes += m[i] == orig[i] ? -1 : 1;
+    }
+  recalcEdited(changed);
+}
+
+
+// Add the rectangles making up a landmass bounding box to a list.
+
+static void addBBox(const IslaModel::BBox &bb, vector<Rect> &boxes)
+{
+  boxes.push_back(bb.b1);
+  if (bb.both) boxes.push_back(bb.b2);
+}
+
+
+// Incremental recalculation after a batch of edits: the flagged
+// cells, plus any cells changed by single-cell edits since the last
+// recalculation.  Landmass indexing, ISMASK and bounding boxes are
+// cheap and are redone from scratch.
+// Island segmentation is the expensive part, so a new island that
+// covers exactly the same cells as an old island (including the
+// ocean cells its index is extended into by calcIsMask), with no
+// edited cells within a cell of the old island's bounding box, just
+// takes over the old island's segmentation (and detail level) under
+// its new index and default name.  Only the remaining islands are
+// segmented again.
+// Settings made by hand survive for landmasses whose cells are
+// unchanged: an island state set with setIsIsland that differs from
+// the size threshold, and the detail level of an island that has to
+// be segmented again.
+
+void IslaModel::recalcEdited(const GridData<bool> &changed)
+{
+  int nlon = gr->nlon(), nlat = gr->nlat();
+  GridData<LMass> oldlm(landmass);
+  LMass oldn = nlandmass;
+  map<LMass, BBox> oldbbox(lmbbox);
+  map<LMass, IslandInfo> oldisles;
+  oldisles.swap(isles);
+  vector<bool> manual(oldn + 1, false);
+  for (LMass o = 1; o <= oldn; ++o)
+    manual[o] = (oldisles.find(o) != oldisles.end()) != islandSized(o);
+
+  calcLandMasses();
+  calcIsMask();
+  calcBBoxes();
+
+  // Old islands whose surroundings include an edited cell.
+  typedef pair<int,int> Cell;
+  vector<Cell> edits;
+  for (int r = 0; r < nlat; ++r)
+    for (int c = 0; c < nlon; ++c)
+      if (changed(r, c) || edited(r, c)) edits.push_back(Cell(r, c));
+  edited = false;
+  edits_pending = false;
+  vector<bool> touched(oldn + 1, false);
+  for (map<LMass, IslandInfo>::const_iterator it = oldisles.begin();
+       it != oldisles.end(); ++it) {
+    const BBox &bb = oldbbox[it->first];
+    for (vector<Cell>::const_iterator e = edits.begin();
+         e != edits.end(); ++e)
+      if (nearBox(bb.b1, e->first, e->second) ||
+          (bb.both && nearBox(bb.b2, e->first, e->second))) {
+        touched[it->first] = true;
+        break;
+      }
+  }
+
+  // Match new landmasses to old ones cell by cell.
+  const LMass NONE = numeric_limits<LMass>::max();
+  vector<LMass> match(nlandmass + 1, NONE);
+  vector<bool> same(nlandmass + 1, true);
+  vector<int> oldcount(oldn + 1, 0), newcount(nlandmass + 1, 0);
+  for (int r = 0; r < nlat; ++r)
+    for (int c = 0; c < nlon; ++c) {
+      LMass o = oldlm(r, c), n = landmass(r, c);
+      if (o != 0) ++oldcount[o];
+      if (n == 0) continue;
+      ++newcount[n];
+      if (match[n] == NONE) match[n] = o;
+      else if (match[n] != o) same[n] = false;
+    }
+
+  // Island states: from the size threshold, except for unchanged
+  // landmasses whose state was set by hand.
+  vector<bool> island(nlandmass + 1, false), kept(nlandmass + 1, false);
+  bool reset = false;
+  for (LMass lm = 1; lm <= nlandmass; ++lm) {
+    LMass o = match[lm];
+    kept[lm] = same[lm] && o != 0 && o != NONE &&
+      oldcount[o] == newcount[lm];
+    island[lm] = islandSized(lm);
+    if (kept[lm] && manual[o]) {
+      island[lm] = !island[lm];
+      reset = true;
+    }
+  }
+  if (reset) {
+    for (int r = 0; r < nlat; ++r)
+      for (int c = 0; c < nlon; ++c)
+        is_island(r, c) = mask(r, c) && island[landmass(r, c)];
+    pyr.build(mask, is_island);
+    rowruns.build(mask, is_island);
+  }
+
+  // Cells can only have changed state in edited landmasses, new
+  // landmasses that aren't an old one with the same cells, and old
+  // landmasses that don't survive as a new one.
+  vector<bool> hit(nlandmass + 1, false), survives(oldn + 1, false);
+  for (vector<Cell>::const_iterator e = edits.begin();
+       e != edits.end(); ++e)
+    hit[landmass(e->first, e->second)] = true;
+  chboxes.clear();
+  for (LMass lm = 1; lm <= nlandmass; ++lm) {
+    if (kept[lm]) survives[match[lm]] = true;
+    if (!kept[lm] || hit[lm]) addBBox(lmbbox[lm], chboxes);
+  }
+  for (LMass o = 1; o <= oldn; ++o)
+    if (!survives[o]) addBBox(oldbbox[o], chboxes);
+
+  for (LMass lm = 1; lm < lmsizes.size(); ++lm) {
+    if (!island[lm]) continue;
+    LMass o = match[lm];
+    map<LMass, IslandInfo>::iterator old =
+      kept[lm] ? oldisles.find(o) : oldisles.end();
+    if (old != oldisles.end() && !touched[o]) {
+      isles[lm] = old->second;
+      isles[lm].name = landmassName(lm);
+    }
+    else if (old != oldisles.end() &&
+             old->second.minsegs != old->second.absminsegs) {
+      isles[lm].minsegs = min(old->second.minsegs, lmcounts[lm]);
+      if (calcIsland(lm))
+        isles[lm].absminsegs = min(old->second.absminsegs,
+                                   isles[lm].minsegs);
+    } else if (calcIsland(lm))
+      isles[lm].absminsegs = isles[lm].segments.size();
+  }
+}
+
+
+void IslaModel::recalcPending(void)
+{
+  if (edits_pending) recalcEdited(GridData<bool>(gr, false));
+  else chboxes.clear();
+}
+
+
+// Is a cell within one cell of a landmass bounding box?  Bounding box
+// columns may run past the end of the grid.
+
+bool IslaModel::nearBox(const Rect &b, int r, int c) const
+{
+  int nlon = gr->nlon();
+  if (r < b.y - 1 || r > b.y + b.height) return false;
+  if (b.width + 2 >= nlon) return true;
+  return ((c - (b.x - 1)) % nlon + nlon) % nlon < b.width + 2;
+}
+
+
 // Index land masses using flood fill.
 
 template<typename T>
@@ -251,18 +1208,50 @@ void IslaModel::calcLandMasses(void)
         lmsizes[landmass(r, c)] += gr->cellArea(r, c);
       }
 
+  classifyLandMasses();
+}
+
+
+// Classify landmasses as island/not-island based on area threshold.
+
+bool IslaModel::islandSized(LMass lm) const
+{
+  return lm >= 1 && lm < nlandmass && lmsizes[lm] <= island_threshold;
+}
+
+void IslaModel::classifyLandMasses(void)
+{
   // Filter for islands based on size threshold.
   set<LMass> island_regions;
-  double island_threshold = IslaPreferences::get()->getIslandThreshold();
   for (LMass i = 1; i < nlandmass; ++i)
-    if (lmsizes[i] <= island_threshold) island_regions.insert(i);
+    if (islandSized(i)) island_regions.insert(i);
 
   // Mark island regions.
+  int nlon = gr->nlon(), nlat = gr->nlat();
   is_island = false;
   for (int r = 0; r < nlat; ++r)
     for (int c = 0; c < nlon; ++c)
-      is_island(r, c) =
+      is_island(r, c) = mask(r, c) &&
         island_regions.find(landmass(r, c)) != island_regions.end();
+  pyr.build(mask, is_island);
+  rowruns.build(mask, is_island);
+}
+
+
+// Reclassify islands after a change of island threshold.  Landmass
+// indexes and ISMASK don't depend on the threshold, and landmasses
+// that were islands before and still are keep their segmentations,
+// so only newly classified islands need to be segmented.
+
+void IslaModel::reclassify(void)
+{
+  classifyLandMasses();
+  for (LMass lm = 1; lm < lmsizes.size(); ++lm) {
+    if (!islandSized(lm))
+      isles.erase(lm);
+    else if (isles.find(lm) == isles.end() && calcIsland(lm))
+      isles[lm].absminsegs = isles[lm].segments.size();
+  }
 }
 
 
@@ -323,7 +1312,7 @@ void IslaModel::calcBBoxes(void)
       if (!found) { --maxc;  break; }
     }
     BBox bbox;
-    bbox.b1 = wxRect(minc, minr, minc != maxc && maxc % nc == minc ?
+    bbox.b1 = Rect(minc, minr, minc != maxc && maxc % nc == minc ?
                      nc : maxc-minc+1, maxr-minr+1);
     if (minc == 2 && bbox.b1.width != nc) {
       bool found = false;
@@ -345,7 +1334,7 @@ void IslaModel::calcBBoxes(void)
           if (!found) { ++minc;  break; }
         }
         bbox.both = true;
-        bbox.b2 = wxRect(minc, minr, maxc-minc+1, maxr-minr+1);
+        bbox.b2 = Rect(minc, minr, maxc-minc+1, maxr-minr+1);
       }
     }
     lmbbox[lm] = bbox;
@@ -370,16 +1359,20 @@ bool IslaModel::calcIsland(LMass lm)
 
   // Set up island info.
   IslandInfo is;
-  char tmp[15];
-  sprintf(tmp, "Landmass %d", lm);
-  is.name = tmp;
-  if (isles.find(lm) != isles.end()) is.minsegs = isles[lm].minsegs;
-  compute.segment(lm, isles[lm].minsegs, is.segments);
-  IslaCompute::coincidence(is.segments, is.vcoinc, is.hcoinc);
+  segmentIsland(compute, lm, isles[lm].minsegs, is);
   isles[lm] = is;
   return true;
 }
 
+void IslaModel::segmentIsland(IslaCompute &compute, LMass lm, int minsegs,
+                              IslandInfo &is) const
+{
+  is.name = landmassName(lm);
+  is.minsegs = minsegs;
+  compute.segment(lm, minsegs, is.segments);
+  IslaCompute::coincidence(is.segments, is.vcoinc, is.hcoinc);
+}
+
 
 // Recalculate island information for all landmasses.
 
@@ -392,6 +1385,46 @@ void IslaModel::calcIslands(void)
 }
 
 
+// Determine islands for a list of thresholds.  Candidate landmasses
+// are sorted by size, so the islands for each threshold are a prefix
+// of the sorted list.  Landmasses that are already islands keep
+// their current segmentations; others are segmented once, at default
+// detail, however many thresholds they are islands for.
+
+void IslaModel::thresholdSweep(const vector<double> &thrs,
+                               ThresholdSweep &sweep) const
+{
+  vector< pair<double, LMass> > bysize;
+  for (LMass lm = 1; lm < nlandmass; ++lm)
+    bysize.push_back(make_pair(lmsizes[lm], lm));
+  sort(bysize.begin(), bysize.end());
+
+  sweep.thresholds = thrs;
+  sweep.islands.assign(thrs.size(), vector<LMass>());
+  sweep.segmentations.clear();
+  IslaCompute compute(landmass, lmbbox, ismask);
+  for (unsigned int i = 0; i < thrs.size(); ++i) {
+    vector<LMass> &isl = sweep.islands[i];
+    for (unsigned int j = 0;
+         j < bysize.size() && bysize[j].first <= thrs[i]; ++j) {
+      LMass lm = bysize[j].second;
+      isl.push_back(lm);
+      if (sweep.segmentations.find(lm) != sweep.segmentations.end())
+        continue;
+      map<LMass, IslandInfo>::const_iterator it = isles.find(lm);
+      if (it != isles.end())
+        sweep.segmentations[lm] = it->second;
+      else {
+        IslandInfo &is = sweep.segmentations[lm];
+        segmentIsland(compute, lm, 1, is);
+        is.absminsegs = is.segments.size();
+      }
+    }
+    sort(isl.begin(), isl.end());
+  }
+}
+
+
 // Segmentation control methods.
 
 void IslaModel::coarsenIsland(int r, int c)
@@ -426,135 +1459,172 @@ void IslaModel::resetIsland(int r, int c)
 
 // File handling functions.
 
-static void swap_bytes(void *buf, int nbytes, int n)
-{
-  unsigned char *cbuf = static_cast<unsigned char *>(buf);
-  for (int i = 0; i < n; ++i) {
-    for (int j = 0; j < nbytes / 2; ++j) {
-      unsigned char temp = cbuf[j];
-      cbuf[j] = cbuf[nbytes - j - 1];
-      cbuf[nbytes - j - 1] = temp;
-    }
-    cbuf += nbytes;
-  }
-}
+// Island data is held in the extra constants section of a UM ocean
+// dump: the island count, then for each island a segment count
+// followed by the segment start and end columns and start and end
+// rows.  Only the header words and extra constants are read from the
+// (memory-mapped) file, whatever its size.
 
-static void readIslandDataFromDump(int grid_nx, int grid_ny, wxFFile &fp,
-                                   vector<IslaModel::IslandInfo> &isl)
+// Check that a UM file is an ocean dump on the right grid with an
+// island data section, returning the section's position and length.
+
+static void checkOceanDump(int grid_nx, int grid_ny, const UMFile &um,
+                           long &offset, long &length)
 {
-  // Check on the dump file type.  We only support 64-bit IEEE files,
-  // but we handle byte-swapping OK.
-  // ==> THIS RELIES ON longs BEING 64 BITS!
-  long ibuf[2];
-  fp.Read(ibuf, 2 * sizeof(long));
-  bool swapped = false;
-  if (ibuf[1] < 1 || ibuf[1] > 4) {
-    swapped = true;
-    swap_bytes(ibuf, sizeof(long), 2);
-    if (ibuf[1] < 1 || ibuf[1] > 4)
-      throw runtime_error("Dump files must be 64-bit byte-swapped IEEE");
-  }
-  if (ibuf[1] != 2)
+  if (um.fixhd(UMFile::FH_SUBMODEL) != 2)
     throw runtime_error("Dump file is not an ocean dump");
 
-  // Read the fixed header and find the offset for the integer
-  // constants and island data.
-  long fixhd[256];
-  fp.Seek(0);
-  fp.Read(fixhd, 256 * sizeof(long));
-  if (swapped) swap_bytes(fixhd, sizeof(long), 256);
-  long int_consts_offset = fixhd[100-1];
-  long int_consts_length = fixhd[101-1];
-  long extra_data_offset = fixhd[130-1];
-  long extra_data_length = fixhd[131-1];
-
-  // Read the integer constants data and check the grid size.
-  long int_data[int_consts_length];
-  fp.Seek((int_consts_offset - 1) * sizeof(long));
-  fp.Read(int_data, int_consts_length * sizeof(long));
-  if (swapped) swap_bytes(int_data, sizeof(long), int_consts_length);
-  long dump_nx = int_data[6-1], dump_ny = int_data[7-1];
+  // Check the grid size against the integer constants.
+  long dump_nx = um.intConst(6), dump_ny = um.intConst(7);
   if (dump_nx != grid_nx + 2 || dump_ny != grid_ny)
     throw runtime_error("Dump file grid does not match land/sea mask");
 
-  // Read the extra constants data.
-  double data[extra_data_length];
-  fp.Seek((extra_data_offset - 1) * sizeof(double));
-  fp.Read(data, extra_data_length * sizeof(double));
-  if (swapped) swap_bytes(data, sizeof(double), extra_data_length);
+  // Find the extra constants data.
+  offset = um.fixhd(UMFile::FH_EXTRA_START);
+  length = um.fixhd(UMFile::FH_EXTRA_LEN);
+  if (length < 1)
+    throw runtime_error("Dump file has no island data");
+  um.checkRange(offset, length, "extra data");
+}
+
+static void readIslandDataFromDump(int grid_nx, int grid_ny, const UMFile &um,
+                                   vector<IslaModel::IslandInfo> &isl)
+{
+  long extra_data_offset, extra_data_length;
+  checkOceanDump(grid_nx, grid_ny, um, extra_data_offset, extra_data_length);
+  size_t data = extra_data_offset;
 
   // Set up island data.
-  isl.resize(static_cast<unsigned int>(data[0]));
-  int idata = 1;
+  double nisl = um.real(data);
+  if (!(nisl >= 0 && nisl <= extra_data_length))
+    throw runtime_error("Format error in dump file island data");
+  isl.resize(static_cast<unsigned int>(nisl));
+  long idata = 1;
   vector<int> isis, ieis, jsis, jeis;
   for (unsigned int iisl = 0; iisl < isl.size(); ++iisl){
     char tmp[32];
     sprintf(tmp, "Island %d", iisl + 1);
     isl[iisl].name = tmp;
-    unsigned int nseg = static_cast<unsigned int>(data[idata++]);
-    if (idata + nseg * 4 > extra_data_length)
+    double dnseg = um.real(data + idata++);
+    if (!(dnseg >= 0 && dnseg <= extra_data_length))
+      throw runtime_error("Format error in dump file island data");
+    unsigned int nseg = static_cast<unsigned int>(dnseg);
+    if (idata + 4 * static_cast<uint64_t>(nseg) >
+        static_cast<uint64_t>(extra_data_length))
       throw runtime_error("Format error in dump file island data");
     isis.clear();  ieis.clear();  jsis.clear();  jeis.clear();
     for (unsigned int i = 0; i < nseg; ++i)
-      isis.push_back(static_cast<unsigned int>(data[idata++]));
+      isis.push_back(static_cast<unsigned int>(um.real(data + idata++)));
     for (unsigned int i = 0; i < nseg; ++i)
-      ieis.push_back(static_cast<unsigned int>(data[idata++]));
+      ieis.push_back(static_cast<unsigned int>(um.real(data + idata++)));
     for (unsigned int i = 0; i < nseg; ++i)
-      jsis.push_back(static_cast<unsigned int>(data[idata++]));
+      jsis.push_back(static_cast<unsigned int>(um.real(data + idata++)));
     for (unsigned int i = 0; i < nseg; ++i)
-      jeis.push_back(static_cast<unsigned int>(data[idata++]));
+      jeis.push_back(static_cast<unsigned int>(um.real(data + idata++)));
     isl[iisl].segments.resize(nseg);
     for (unsigned int i = 0; i < nseg; ++i)
       isl[iisl].segments[i] =
-        wxRect(isis[i], jsis[i], ieis[i]-isis[i]+1, jeis[i]-jsis[i]+1);
+        Rect(isis[i], jsis[i], ieis[i]-isis[i]+1, jeis[i]-jsis[i]+1);
+  }
+}
+
+// ASCII island files.  The file is mapped and scanned in place, line
+// by line, with a simple integer lexer, so nothing is allocated per
+// line or per token.
+
+static bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Lex a decimal integer (with optional sign) that must be followed by
+// whitespace or the end of the line.  Returns a pointer past the
+// integer, or null if the token isn't a valid integer.
+
+static const char *lexInt(const char *p, const char *e, long &val)
+{
+  bool neg = false;
+  if (p < e && (*p == '+' || *p == '-')) neg = *p++ == '-';
+  if (p == e || *p < '0' || *p > '9') return 0;
+  unsigned long v = 0;
+  unsigned long lim = neg ?
+    static_cast<unsigned long>(numeric_limits<long>::max()) + 1 :
+    static_cast<unsigned long>(numeric_limits<long>::max());
+  for (; p < e && *p >= '0' && *p <= '9'; ++p) {
+    unsigned long d = *p - '0';
+    if (v > (lim - d) / 10) return 0;
+    v = v * 10 + d;
   }
+  if (p < e && !isBlank(*p)) return 0;
+  if (!neg) val = v;
+  else val = v == 0 ? 0 : -static_cast<long>(v - 1) - 1;
+  return p;
 }
 
-static bool parseASCIIIslands(int grid_nx, int grid_ny, wxString fname,
+static void parseError(const string &fname, int lineno, const char *msg)
+{
+  ostringstream oss;
+  oss << fname << ", line " << lineno << ": " << msg;
+  throw runtime_error(oss.str());
+}
+
+static bool parseASCIIIslands(int grid_nx, int grid_ny, string fname,
                               vector<IslaModel::IslandInfo> &isl)
 {
-  // Read whole file contents.
-  wxTextFile fp(fname);
-  if (!fp.Open())
-    throw runtime_error(string("Cannot open file: ") +
-                        string(fname.char_str()));
+  MappedFile mf(fname);
+  mf.adviseSequential();
+  const char *p = reinterpret_cast<const char *>(mf.data());
+  const char *end = p + mf.size();
 
   // Process line by line.
   enum State { BEFORE_COUNT, BEFORE_SEGS, READING_SEGS };
   State state = BEFORE_COUNT;
-  int iisl = 0, istep = 0, iseg = 0, nseg = 0;
-  wxString islandname = _("");
+  int iisl = 0, istep = 0, iseg = 0, nseg = 0, lineno = 0;
+  string islandname = "";
   vector<int> isis, ieis, jsis, jeis;
   bool bad = false;
-  for (wxString line = fp.GetFirstLine(); !fp.Eof(); line = fp.GetNextLine()) {
-    line = line.Trim();
-    if (line.Len() == 0) continue;
-    if (line[0] == wxChar('#')) {
+  while (p < end) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (!eol) eol = end;
+    ++lineno;
+    const char *e = eol;
+    while (e > p && isBlank(e[-1])) --e;
+    if (e == p) { p = eol < end ? eol + 1 : end;  continue; }
+    if (*p == '#') {
       // Comment line: if this is in the "BEFORE_SEGS" state, we
       // assume that it's a comment giving the name of the island.
-      if (state == BEFORE_SEGS) islandname = line.Mid(1).Trim();
+      if (state == BEFORE_SEGS) islandname.assign(p + 1, e);
     } else {
       // Should be a whitespace separated string of integers.
-      wxStringTokenizer tok(line);
-      while (tok.HasMoreTokens()) {
+      const char *q = p;
+      while (true) {
+        while (q < e && isBlank(*q)) ++q;
+        if (q == e) break;
         long val;
-        if (!tok.GetNextToken().ToLong(&val))
-          throw runtime_error("Failed to convert integer");
+        q = lexInt(q, e, val);
+        if (!q) parseError(fname, lineno, "Failed to convert integer");
         switch (state) {
         case BEFORE_COUNT:
+          if (val < 0) parseError(fname, lineno, "Invalid island count");
           isl.resize(val);
           state = BEFORE_SEGS;
           break;
         case BEFORE_SEGS: {
-          if (islandname.Len() == 0) {
+          if (iisl >= static_cast<int>(isl.size()))
+            parseError(fname, lineno, "Too many islands");
+          if (val < 0) parseError(fname, lineno, "Invalid segment count");
+          if (islandname.size() == 0) {
             char tmp[32];
             sprintf(tmp, "Island %d", iisl + 1);
             isl[iisl].name = tmp;
-          } else isl[iisl].name = islandname.ToAscii();
-          islandname = _("");
+          } else isl[iisl].name = islandname;
+          islandname = "";
           isis.clear();  ieis.clear();  jsis.clear();  jeis.clear();
           nseg = val;  istep = 0;  iseg = 0;
-          state = READING_SEGS;
+          if (nseg == 0)
+            ++iisl;
+          else
+            state = READING_SEGS;
           break;
         }
         case READING_SEGS: {
@@ -586,8 +1656,8 @@ static bool parseASCIIIslands(int grid_nx, int grid_ny, wxString fname,
               isl[iisl].segments.resize(nseg);
               for (int i = 0; i < nseg; ++i)
                 isl[iisl].segments[i] =
-                  wxRect(isis[i], jsis[i],
-                         ieis[i]-isis[i]+1, jeis[i]-jsis[i]+1);
+                  Rect(isis[i], jsis[i],
+                       ieis[i]-isis[i]+1, jeis[i]-jsis[i]+1);
               ++iisl;
               state = BEFORE_SEGS;
             }
@@ -597,72 +1667,163 @@ static bool parseASCIIIslands(int grid_nx, int grid_ny, wxString fname,
         }
       }
     }
+    p = eol < end ? eol + 1 : end;
   }
   return !bad;
 }
 
-void IslaModel::saveIslands(wxString fname)
+// Binary island files (see IslandWriter.hh for the layout).  Segment
+// bounds are clamped to the grid as for ASCII files.
+
+static unsigned long readVarint(const unsigned char *&p,
+                                const unsigned char *end, const string &fname)
 {
-  wxTextFile fp(fname);
-  if (fp.Exists()) { fp.Open(); fp.Clear(); } else fp.Create();
+  unsigned long val = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    unsigned char b = *p++;
+    val |= static_cast<unsigned long>(b & 0x7F) << shift;
+    if (!(b & 0x80)) return val;
+  }
+  throw runtime_error("Format error in binary island file: " + fname);
+}
 
-  fp.AddLine(_("# Island file"));
-  fp.AddLine(_(""));
-  fp.AddLine(wxString::Format(_("%d"), isles.size()));
-  for (map<LMass, IslandInfo>::const_iterator it = isles.begin();
-       it != isles.end(); ++it) {
-    const IslandInfo &is = it->second;
-    fp.AddLine(_(""));
-    fp.AddLine(wxString(_("# ")) + wxString::FromAscii(is.name.c_str()));
-    const vector<wxRect> &segs = is.segments;
-    fp.AddLine(wxString::Format(_("%d"), segs.size()));
-    bool firstseg = true;
-    wxString isis, ieis, jsis, jeis;
-    for (unsigned int i = 0; i < segs.size(); ++i) {
-      if (!firstseg) {
-        isis += _(" "); ieis += _(" "); jsis += _(" "); jeis += _(" ");
+static bool parseBinaryIslands(int grid_nx, int grid_ny, string fname,
+                               vector<IslaModel::IslandInfo> &isl)
+{
+  MappedFile mf(fname);
+  mf.adviseSequential();
+  const unsigned char *p = mf.data(), *end = p + mf.size();
+  p += sizeof(IslandWriter::MAGIC);
+  if (readVarint(p, end, fname) != IslandWriter::VERSION)
+    throw runtime_error("Unsupported binary island file version: " + fname);
+  unsigned long nisl = readVarint(p, end, fname);
+  if (nisl > mf.size())
+    throw runtime_error("Format error in binary island file: " + fname);
+  isl.resize(nisl);
+  bool bad = false;
+  const long lo[4] = { 2, 2, 1, 1 };
+  const long hi[4] = { grid_nx + 1, grid_nx + 1, grid_ny, grid_ny };
+  for (unsigned long i = 0; i < nisl; ++i) {
+    unsigned long nlen = readVarint(p, end, fname);
+    if (nlen > static_cast<unsigned long>(end - p))
+      throw runtime_error("Format error in binary island file: " + fname);
+    isl[i].name.assign(reinterpret_cast<const char *>(p), nlen);
+    p += nlen;
+    unsigned long nseg = readVarint(p, end, fname);
+    if (nseg > static_cast<unsigned long>(end - p) / 4)
+      throw runtime_error("Format error in binary island file: " + fname);
+    isl[i].segments.resize(nseg);
+    for (unsigned long j = 0; j < nseg; ++j) {
+      long b[4];
+      for (int k = 0; k < 4; ++k) {
+        unsigned long v = readVarint(p, end, fname);
+        b[k] = v > static_cast<unsigned long>(hi[k]) ? hi[k] : v;
+        if (b[k] < lo[k]) b[k] = lo[k];
+        if (static_cast<long>(v) != b[k]) bad = true;
       }
-      firstseg = false;
-      isis += wxString::Format(_("%d"), segs[i].x);
-      ieis += wxString::Format(_("%d"), segs[i].x + segs[i].width - 1);
-      jsis += wxString::Format(_("%d"), segs[i].y);
-      jeis += wxString::Format(_("%d"), segs[i].y + segs[i].height - 1);
+      isl[i].segments[j] = Rect(b[0], b[2], b[1] - b[0] + 1, b[3] - b[2] + 1);
     }
-    fp.AddLine(isis);
-    fp.AddLine(ieis);
-    fp.AddLine(jsis);
-    fp.AddLine(jeis);
   }
+  return !bad;
+}
+
+void IslaModel::saveIslands(string fname, IslandWriter::Format fmt) const
+{
+  ios_base::openmode mode = ios_base::out | ios_base::trunc;
+  if (fmt == IslandWriter::BINARY) mode |= ios_base::binary;
+  ofstream fp(fname.c_str(), mode);
+  if (!fp)
+    throw runtime_error(string("Cannot open file: ") + fname);
+  try {
+    saveIslands(fp, fmt);
+  } catch (runtime_error &) {
+    throw runtime_error(string("Failed writing island file: ") + fname);
+  }
+}
+
+void IslaModel::saveIslands(ostream &fp, IslandWriter::Format fmt) const
+{
+  IslandWriter w(fp, fmt);
+  w.begin(isles.size());
+  for (map<LMass, IslandInfo>::const_iterator it = isles.begin();
+       it != isles.end(); ++it)
+    w.island(it->second.name, it->second.segments);
+  w.flush();
+}
+
+// Write islands into the island data section of an existing UM ocean
+// dump, in the layout read by readIslandDataFromDump.  If the new
+// data fits in the existing section it is written in place through
+// the file mapping and any words left over are zeroed; otherwise the
+// section is first grown, which moves only the part of the dump that
+// follows it.
 
-  fp.Write();
+void IslaModel::saveIslandsToDump(string fname) const
+{
+  vector<double> data(1, isles.size());
+  for (map<LMass, IslandInfo>::const_iterator it = isles.begin();
+       it != isles.end(); ++it) {
+    const vector<Rect> &segs = it->second.segments;
+    data.push_back(segs.size());
+    for (unsigned int i = 0; i < segs.size(); ++i)
+      data.push_back(segs[i].x);
+    for (unsigned int i = 0; i < segs.size(); ++i)
+      data.push_back(segs[i].x + segs[i].width - 1);
+    for (unsigned int i = 0; i < segs.size(); ++i)
+      data.push_back(segs[i].y);
+    for (unsigned int i = 0; i < segs.size(); ++i)
+      data.push_back(segs[i].y + segs[i].height - 1);
+  }
+
+  UMFile um(fname, true);
+  long offset, length;
+  checkOceanDump(gr->nlon(), gr->nlat(), um, offset, length);
+  long n = data.size();
+  if (n > length) {
+    length += um.insert(offset + length, n - length);
+    um.setWord(UMFile::FH_EXTRA_LEN, length);
+  }
+  for (long i = 0; i < n; ++i) um.setReal(offset + i, data[i]);
+  for (long i = n; i < length; ++i) um.setReal(offset + i, 0.0);
+  um.sync();
+}
+
+void IslaModel::writeSegments(ostream &fp, const vector<Rect> &segs)
+{
+  IslandWriter w(fp);
+  w.segments(segs);
+  w.flush();
 }
 
-bool IslaModel::loadIslands(wxString fname, vector<IslandInfo> &isles)
+bool IslaModel::loadIslands(string fname, vector<IslandInfo> &isles)
 {
   // Check that the file exists.
-  wxFFile fp(fname, _("rb"));
-  if (!fp.IsOpened())
-    throw runtime_error(string("Cannot open file: ") +
-                        string(fname.char_str()));
+  FILE *fp = fopen(fname.c_str(), "rb");
+  if (!fp)
+    throw runtime_error(string("Cannot open file: ") + fname);
 
   // Determine whether it's a binary file or an ASCII file.  This is a
   // bit hit-and-miss: just read 128 bytes from the file and check
   // whether any of the values are outside the ASCII 7-bit range.
   char buff[128];
-  size_t nread = fp.Read(buff, 128);
-  fp.Seek(0);
+  size_t nread = fread(buff, 1, 128, fp);
+  fclose(fp);
   bool binary = false;
   for (size_t i = 0; i < nread; ++i)
     if (buff[i] & 0x80) { binary = true; break; }
 
   // Read raw island data from dump file, checking that it's a
-  // suitable ocean dump file as we do so, or parse an ASCII islands
-  // file.
+  // suitable ocean dump file as we do so, or parse a binary or ASCII
+  // islands file.
   vector<IslandInfo> isltmp;
   bool ok = true;
-  if (binary)
-    readIslandDataFromDump(gr->nlon(), gr->nlat(), fp, isltmp);
-  else
+  if (nread >= sizeof(IslandWriter::MAGIC) &&
+      memcmp(buff, IslandWriter::MAGIC, sizeof(IslandWriter::MAGIC)) == 0)
+    ok = parseBinaryIslands(gr->nlon(), gr->nlat(), fname, isltmp);
+  else if (binary) {
+    UMFile um(fname);
+    readIslandDataFromDump(gr->nlon(), gr->nlat(), um, isltmp);
+  } else
     ok = parseASCIIIslands(gr->nlon(), gr->nlat(), fname, isltmp);
 
   // Compute coincidence line segments for island display.
@@ -673,7 +1834,7 @@ bool IslaModel::loadIslands(wxString fname, vector<IslandInfo> &isles)
   // Check...
   // cout << "#islands = " << isltmp.size() << endl;
   // for (int i = 0; i < isltmp.size(); ++i) {
-  //   vector<wxRect> &ss = isltmp[i].segments;
+  //   vector<Rect> &ss = isltmp[i].segments;
   //   cout << "  " << i+1 << ": " << isltmp[i].name
   //        << " (" << ss.size() << ")" << endl;
   //   for (int j = 0; j < ss.size(); ++j)
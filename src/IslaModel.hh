@@ -12,15 +12,22 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <iosfwd>
 
-#include <wx/gdicmn.h>
 #include "GridData.hh"
+#include "Rect.hh"
+#include "MaskPyramid.hh"
+#include "MaskRuns.hh"
+#include "EditJournal.hh"
+#include "IslandWriter.hh"
 
 // Here, "mask" means a boolean land/sea mask (with true for land,
 // false for ocean).
 
 typedef unsigned int LMass;
 
+class IslaCompute;
+
 class IslaModel {
 public:
   enum GridType { HadCM3L, HadCM3, HadGEM2 };
@@ -30,7 +37,7 @@ public:
   struct BBox {
     BBox() : both(false) { }
     bool both;
-    wxRect b1, b2;
+    Rect b1, b2;
   };
 
   // Structures used for recording island information.
@@ -39,19 +46,39 @@ public:
     IslandInfo(): minsegs(1), absminsegs(1) { }
     std::string name;
     int minsegs, absminsegs;
-    std::vector<wxRect> segments;
+    std::vector<Rect> segments;
     CoincInfo vcoinc;
     CoincInfo hcoinc;
   };
 
+  // Results of an island threshold sweep.  Island sets for increasing
+  // thresholds are nested, so each island landmass is segmented only
+  // once and its segmentation is shared by all thresholds.
+  struct ThresholdSweep {
+    std::vector<double> thresholds;             // Thresholds (km^2).
+    std::vector< std::vector<LMass> > islands;  // Islands per threshold.
+    std::map<LMass, IslandInfo> segmentations;  // Segments per island.
+  };
+
 
   // Create a default model: HadCM3L grid, no land, island threshold
   // set at 8.0E6 km^2 (big enough to include Australia).
-  IslaModel();
+  IslaModel(GridType g = HadCM3L, double thr = 8.0E6);
   ~IslaModel() { }
 
   // Access grid.
-  GridPtr grid(void) { return gr; }
+  GridPtr grid(void) const { return gr; }
+
+  // Standard model grids.
+  static GridPtr makeGrid(GridType g);
+  static const char *gridName(GridType g);
+
+  // Grid type used for empty masks and island area threshold (km^2).
+  // Changes take effect at the next reset or recalculation.
+  GridType gridType(void) const { return gridtype; }
+  void setGridType(GridType g) { gridtype = g; }
+  double islandThreshold(void) const { return island_threshold; }
+  void setIslandThreshold(double thr) { island_threshold = thr; }
 
   // Reset to original empty mask.
   void reset(void);
@@ -59,8 +86,37 @@ public:
   // Load a new mask from a NetCDF file.
   void loadMask(std::string file, std::string var);
 
-  // Save current mask to NetCDF file.
-  void saveMask(std::string file);
+  // Find mask variable name: if there's only one variable in the
+  // file apart from the coordinate variables, we use that.  Files
+  // written by saveMask with derived fields use "mask".
+  static std::string findMaskVar(netCDF::NcFile &nc);
+  static bool hasDerived(netCDF::NcFile &nc);
+
+  // Load a new mask from the land/sea mask field (STASH code 30) of
+  // an unpacked UM ancillary file, fieldsfile or dump, or just read
+  // the mask.
+  void loadUMMask(std::string file);
+  static GridData<bool> readUMMask(std::string file);
+
+  // Load a new mask from mask data already in memory.
+  void loadMask(const GridData<bool> &new_mask);
+
+  // Save current mask to NetCDF file, optionally along with the
+  // derived landmass, ISMASK and island fields, landmass bounding
+  // boxes and island segmentations.  Loading a mask from a file with
+  // derived data skips the landmass and island calculations if the
+  // data is consistent with the mask and island threshold.
+  // Compressed files are NetCDF-4, with compact integer types and
+  // deflated lat/lon tile chunks.
+  void saveMask(std::string file, bool derived = false,
+                bool compressed = false);
+
+  // Save or restore the whole model state, with a set of comparison
+  // islands, as a binary session file (see SessionFile.hh).
+  // Restoring a session needs no recalculation.
+  void saveSession(std::string file,
+                   const std::vector<IslandInfo> &comp) const;
+  void loadSession(std::string file, std::vector<IslandInfo> &comp);
 
   // Extract data values.
   bool maskVal(int r, int c) { return mask(r, c); }
@@ -68,7 +124,14 @@ public:
   bool isIsland(int r, int c) { return is_island(r, c); }
   LMass landMass(int r, int c) { return landmass(r, c); }
   int isMask(int r, int c) { return ismask(r, c); }
-  const std::map<LMass, IslandInfo> islands(void) const { return isles; }
+  LMass landMassCount(void) const { return nlandmass; }
+  const std::map<LMass, IslandInfo> &islands(void) const { return isles; }
+
+  // Multi-resolution summary of current mask and island cells.
+  const MaskPyramid &pyramid(void) const { return pyr; }
+
+  // Run-length encoded mask rows.
+  const MaskRuns &runs(void) const { return rowruns; }
 
   // Change data values.
   void setMask(int r, int c, bool val) {
@@ -76,9 +139,51 @@ public:
     if (old == orig && val != orig) ++grid_changes;
     else if (old != orig && val == orig) --grid_changes;
     mask(r, c) = val;
+    pyr.update(r, c, val, is_island(r, c));
+    if (val != old) {
+      rowruns.updateRow(r, mask, is_island);
+      journal.record(r * gr->nlon() + c);
+      edited(r, c) = true;
+      edits_pending = true;
+    }
   }
   void setIsIsland(int cr, int cc, bool val);
 
+  // Bulk mask edits.  A selection is a packed grid of flags marking
+  // cells; the select methods add cells to a selection, and
+  // setMaskRegion sets all selected cells in one batch, then does a
+  // single incremental recalculation.  Returns the number of cells
+  // changed.
+  void selectRect(int r0, int c0, int r1, int c1,
+                  GridData<bool> &sel) const;
+  void selectPolygon(const std::vector<std::pair<double, double> > &lonlat,
+                     GridData<bool> &sel) const;
+  void selectConnected(int r, int c, GridData<bool> &sel) const;
+  int setMaskRegion(const GridData<bool> &sel, bool val);
+
+  // Undo and redo mask edits.  Single-cell edits made between
+  // beginEdit and endEdit (e.g. one mouse drag) form a single undo
+  // step; each setMaskRegion call is always a step of its own.
+  // Landmasses and islands are not updated by single-cell edits
+  // themselves: endEdit does one incremental recalculation for all
+  // the cells edited, as setMaskRegion does for a bulk edit, and undo
+  // and redo go through the same recalculation for the cells they
+  // flip, so an edit and its undo leave the same islands as a
+  // recalculation.  Undo and redo return false if there was nothing
+  // to do.
+  void beginEdit(void) { journal.begin(); }
+  void endEdit(void) { journal.end();  recalcPending(); }
+  bool undo(void);
+  bool redo(void);
+  bool canUndo(void) const { return journal.canUndo(); }
+  bool canRedo(void) const { return journal.canRedo(); }
+
+  // Cell boxes covering every cell whose mask or island state was
+  // changed by the last incremental recalculation (after an edit
+  // stroke, region edit, undo or redo).  Box columns may run past
+  // the end of the grid.
+  const std::vector<Rect> &changedBoxes(void) const { return chboxes; }
+
   // Check for changes in grid or islands from the values generated
   // from the originally loaded mask data.  These are used as
   // indicators that there are changes that might need to be saved
@@ -89,12 +194,26 @@ public:
   // Recalculate everything: land masses, ISMASK, islands.
   void recalcAll(void);
 
+  // Recalculate after a bulk edit of the flagged cells, keeping the
+  // segmentations of islands the edit can't have affected.
+  void recalcEdited(const GridData<bool> &changed);
+
+  // Recalculate for any single-cell edits not yet accounted for.
+  void recalcPending(void);
+
   // Individual recalculation methods.
   void calcLandMasses(void);    // Index land masses.
+  void classifyLandMasses(void); // Mark island landmasses.
   void calcIsMask(void);        // Calculate ISMASK.
   void calcBBoxes(void);        // Calculate landmass bounding boxes.
   bool calcIsland(LMass lm);    // Analyse single island.
   void calcIslands(void);       // Determine islands from scratch.
+  void reclassify(void);        // Update islands for new threshold.
+
+  // Classify and segment islands for a list of thresholds in one
+  // pass, without changing the current model state.
+  void thresholdSweep(const std::vector<double> &thrs,
+                      ThresholdSweep &sweep) const;
 
   // Control island segmentation level of detail.
   void coarsenIsland(int r, int c);
@@ -104,14 +223,46 @@ public:
   // Return landmass bounding box map.
   const std::map<LMass,BBox> landMassBBox(void) const { return lmbbox; }
 
-  // Export current island data.
-  void saveIslands(wxString file);
+  // Export current island data, as an ASCII island file or in the
+  // compact binary format.
+  void saveIslands(std::string file,
+                   IslandWriter::Format fmt = IslandWriter::ASCII) const;
+  void saveIslands(std::ostream &os,
+                   IslandWriter::Format fmt = IslandWriter::ASCII) const;
+
+  // Write island data into an existing UM ocean dump.
+  void saveIslandsToDump(std::string file) const;
+
+  // Write a segment list in island file format: segment count, then
+  // lines of start and end columns and start and end rows.
+  static void writeSegments(std::ostream &os, const std::vector<Rect> &segs);
 
   // Load comparison island data.
-  bool loadIslands(wxString fname, std::vector<IslandInfo> &isles);
+  bool loadIslands(std::string fname, std::vector<IslandInfo> &isles);
 
 private:
-  static GridPtr makeGrid(GridType g);
+  // Set up new mask data, without recalculation.
+  void setupMask(const GridData<bool> &new_mask);
+
+  // Load derived data saved by saveMask, returning false if it's
+  // missing or doesn't match the current mask and threshold.
+  bool loadDerived(netCDF::NcFile &nc);
+
+  // Is a landmass small enough to be an island?
+  bool islandSized(LMass lm) const;
+
+  // Is a cell within one cell of a bounding box?
+  bool nearBox(const Rect &b, int r, int c) const;
+
+  // Flip the cells in a journal entry.
+  void applyDelta(const EditJournal::Delta &d);
+
+  // Segment a single landmass.
+  void segmentIsland(IslaCompute &compute, LMass lm, int minsegs,
+                     IslandInfo &is) const;
+
+  GridType gridtype;            // Grid type for empty masks.
+  double island_threshold;      // Island area threshold (km^2).
 
   std::string maskfile;         // Input mask NetCDF file.
   std::string maskvar;          // Input mask NetCDF variable name.
@@ -128,6 +279,12 @@ private:
   std::vector<double> lmsizes;  // Land mass sizes.
   GridData<bool> is_island;     // Are land points part of an island?
   GridData<int> ismask;         // UM ISMASK for current mask.
+  MaskPyramid pyr;              // Mask/island summary pyramid.
+  MaskRuns rowruns;             // Mask/island row runs.
+  EditJournal journal;          // Mask edit undo/redo history.
+  GridData<bool> edited;        // Cells edited since recalculation.
+  bool edits_pending;           // Any cells in edited?
+  std::vector<Rect> chboxes;    // Boxes changed by last recalculation.
 
   // Map from landmass ID to island information.
   std::map<LMass, IslandInfo> isles;
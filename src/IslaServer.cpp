@@ -0,0 +1,284 @@
+//----------------------------------------------------------------------
+// FILE:   IslaServer.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Long-running Isla service listening on a Unix domain socket.
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+using namespace std;
+
+#include "ncFile.h"
+using namespace netCDF;
+
+#include "IslaServer.hh"
+#include "UMFile.hh"
+
+
+// Create listening socket.  Anything already at the socket path is
+// only removed if it's a socket left behind by a server that has
+// gone away: other files are never touched, and a socket that still
+// accepts connections means another server is running.
+
+IslaServer::IslaServer(string socket_path, double thr) :
+  path(socket_path), threshold(thr), listenfd(-1), stopping(false)
+{
+  sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path))
+    throw runtime_error("Socket path too long: " + path);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+  struct stat st;
+  if (lstat(path.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode))
+      throw runtime_error("Socket path exists and is not a socket: " + path);
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0)
+      throw runtime_error(string("Failed to create socket: ") +
+                          strerror(errno));
+    bool live =
+      connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    close(probe);
+    if (live) throw runtime_error("Socket already in use: " + path);
+    unlink(path.c_str());
+  }
+  listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenfd < 0)
+    throw runtime_error(string("Failed to create socket: ") + strerror(errno));
+  if (bind(listenfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(listenfd, 16) < 0) {
+    string msg = strerror(errno);
+    close(listenfd);
+    throw runtime_error("Failed to listen on " + path + ": " + msg);
+  }
+}
+
+IslaServer::~IslaServer()
+{
+  if (listenfd >= 0) close(listenfd);
+  unlink(path.c_str());
+}
+
+
+// Accept loop: each connection is served on its own thread.  Once a
+// shutdown has been requested, remaining connections stop reading
+// further requests and are waited for before returning.
+
+void IslaServer::run(void)
+{
+  while (!stopping) {
+    int fd = accept(listenfd, 0, 0);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      if (stopping) break;
+      throw runtime_error(string("Failed to accept connection: ") +
+                          strerror(errno));
+    }
+    {
+      lock_guard<mutex> lock(connlock);
+      conns.insert(fd);
+    }
+    try {
+      thread(&IslaServer::connection, this, fd).detach();
+    } catch (std::exception &) {
+      lock_guard<mutex> lock(connlock);
+      conns.erase(fd);
+      close(fd);
+      throw;
+    }
+  }
+  unique_lock<mutex> lock(connlock);
+  for (set<int>::const_iterator it = conns.begin(); it != conns.end(); ++it)
+    shutdown(*it, SHUT_RD);
+  while (!conns.empty()) conndone.wait(lock);
+}
+
+
+// Serve requests on a single connection, one line at a time.
+
+void IslaServer::connection(int fd)
+{
+  Local local;
+  string buf;
+  char tmp[4096];
+  bool open = true;
+  while (open) {
+    ssize_t n = read(fd, tmp, sizeof(tmp));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    buf.append(tmp, n);
+    string::size_type eol;
+    while (open && (eol = buf.find('\n')) != string::npos) {
+      string line = buf.substr(0, eol);
+      buf.erase(0, eol + 1);
+      ostringstream resp;
+      open = request(line, resp, local);
+      string out = resp.str();
+      const char *p = out.data();
+      size_t left = out.size();
+      while (left > 0) {
+        ssize_t w = write(fd, p, left);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) { open = false;  break; }
+        p += w;  left -= w;
+      }
+    }
+  }
+  if (stopping) shutdown(listenfd, SHUT_RDWR);
+  lock_guard<mutex> lock(connlock);
+  conns.erase(fd);
+  close(fd);
+  conndone.notify_all();
+}
+
+
+// Find a cached mask, loading it if necessary.
+
+IslaServer::EntryPtr IslaServer::find(const string &file)
+{
+  {
+    lock_guard<mutex> lock(cachelock);
+    map<string, EntryPtr>::iterator it = cache.find(file);
+    if (it != cache.end()) return it->second;
+  }
+  return load(file, "");
+}
+
+IslaServer::EntryPtr IslaServer::load(const string &file, const string &var)
+{
+  EntryPtr e(new Entry(threshold));
+  boost::shared_ptr< GridData<bool> > mask;
+  if (UMFile::isUMFile(file))
+    mask.reset(new GridData<bool>(IslaModel::readUMMask(file)));
+  else {
+    lock_guard<mutex> lock(nclock);
+    NcFile nc(file, NcFile::read);
+    string maskvar = var != "" ? var : IslaModel::findMaskVar(nc);
+    if (maskvar == "mask" && IslaModel::hasDerived(nc))
+      // Saved derived data is loaded without recalculation.
+      e->model.loadMask(file, maskvar);
+    else {
+      GridPtr gr(new Grid(nc));
+      mask.reset(new GridData<bool>(gr, nc, maskvar));
+    }
+  }
+  if (mask) e->model.loadMask(*mask);
+  lock_guard<mutex> lock(cachelock);
+  cache[file] = e;
+  return e;
+}
+
+
+// Model to use for a request: the connection's own copy if it has
+// one, otherwise the cached model, locked.
+
+const IslaModel &IslaServer::use(const string &file, Local &local,
+                                 EntryPtr &e, unique_lock<mutex> &lock)
+{
+  Local::const_iterator it = local.find(file);
+  if (it != local.end()) return *it->second;
+  e = find(file);
+  lock = unique_lock<mutex>(e->lock);
+  return e->model;
+}
+
+
+// Process a single request.
+
+bool IslaServer::request(const string &line, ostream &os, Local &local)
+{
+  istringstream in(line);
+  string cmd, file;
+  in >> cmd;
+  try {
+    if (cmd == "") {
+      os << "ERR empty request" << endl;
+    } else if (cmd == "quit") {
+      os << "OK" << endl;
+      return false;
+    } else if (cmd == "shutdown") {
+      os << "OK" << endl;
+      stopping = true;
+      return false;
+    } else if (cmd == "list") {
+      lock_guard<mutex> lock(cachelock);
+      os << "OK " << cache.size() << endl;
+      for (map<string, EntryPtr>::const_iterator it = cache.begin();
+           it != cache.end(); ++it)
+        os << it->first << endl;
+      os << "." << endl;
+    } else {
+      if (!(in >> file)) throw runtime_error("missing file name");
+      if (cmd == "load") {
+        string var;
+        in >> var;
+        local.erase(file);
+        EntryPtr e = load(file, var);
+        lock_guard<mutex> lock(e->lock);
+        IslaModel &m = e->model;
+        os << "OK " << m.grid()->nlon() << " " << m.grid()->nlat() << " "
+           << m.landMassCount() << " " << m.islands().size() << endl;
+      } else if (cmd == "unload") {
+        bool had = local.erase(file) > 0;
+        lock_guard<mutex> lock(cachelock);
+        if (cache.erase(file) == 0 && !had)
+          throw runtime_error("not loaded: " + file);
+        os << "OK" << endl;
+      } else if (cmd == "threshold") {
+        double thr;
+        if (!(in >> thr) || thr <= 0.0)
+          throw runtime_error("invalid threshold");
+        boost::shared_ptr<IslaModel> &m = local[file];
+        if (!m) {
+          try {
+            EntryPtr e = find(file);
+            lock_guard<mutex> lock(e->lock);
+            m.reset(new IslaModel(e->model));
+          } catch (...) {
+            local.erase(file);
+            throw;
+          }
+        }
+        m->setIslandThreshold(thr);
+        m->reclassify();
+        os << "OK " << m->islands().size() << endl;
+      } else if (cmd == "islands") {
+        EntryPtr e;
+        unique_lock<mutex> lock;
+        const IslaModel &m = use(file, local, e, lock);
+        ostringstream body;
+        m.saveIslands(body);
+        os << "OK " << m.islands().size() << endl
+           << body.str() << "." << endl;
+      } else if (cmd == "landmass") {
+        LMass lm;
+        if (!(in >> lm)) throw runtime_error("invalid landmass index");
+        EntryPtr e;
+        unique_lock<mutex> lock;
+        const IslaModel &m = use(file, local, e, lock);
+        const map<LMass, IslaModel::IslandInfo> &isles = m.islands();
+        map<LMass, IslaModel::IslandInfo>::const_iterator it = isles.find(lm);
+        if (it == isles.end()) throw runtime_error("landmass is not an island");
+        os << "OK " << it->second.name << endl;
+        IslaModel::writeSegments(os, it->second.segments);
+        os << "." << endl;
+      } else
+        throw runtime_error("unknown request: " + cmd);
+    }
+  } catch (std::exception &e) {
+    os << "ERR " << e.what() << endl;
+  }
+  return true;
+}
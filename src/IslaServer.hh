@@ -0,0 +1,90 @@
+//----------------------------------------------------------------------
+// FILE:   IslaServer.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Long-running Isla service listening on a Unix domain socket.
+// Loaded masks are kept resident, along with their landmass areas
+// and island segmentations, so that repeated requests for the same
+// mask file don't pay for process startup, NetCDF reading or
+// recalculation.
+//
+// Requests are single lines of whitespace separated words:
+//
+//   load FILE [VAR]        Load (or reload) a mask file.
+//   threshold FILE THR     Reclassify islands for a new threshold
+//                          (for this connection only).
+//   islands FILE           Return all islands in island file format.
+//   landmass FILE LM       Return segments for a single landmass.
+//   unload FILE            Drop a mask file from the cache.
+//   list                   List cached mask files.
+//   quit                   Close the connection.
+//   shutdown               Stop the server.
+//
+// A threshold request gives the connection its own copy of the mask,
+// so that other clients continue to see islands for the default
+// threshold.
+//
+// Responses start with a line "OK ..." or "ERR message".  Multi-line
+// responses are terminated by a line containing a single ".".
+//----------------------------------------------------------------------
+
+#ifndef _H_ISLASERVER_
+#define _H_ISLASERVER_
+
+#include <string>
+#include <map>
+#include <set>
+#include <iosfwd>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <boost/shared_ptr.hpp>
+
+#include "IslaModel.hh"
+
+class IslaServer {
+public:
+  IslaServer(std::string socket_path, double threshold);
+  ~IslaServer();
+
+  // Accept and serve connections until a shutdown request arrives.
+  // Returns once all connections have been closed.
+  void run(void);
+
+  // Masks private to a connection, keyed by file name.
+  typedef std::map< std::string, boost::shared_ptr<IslaModel> > Local;
+
+  // Process a single request line, writing the response.  Returns
+  // false if the connection should be closed.
+  bool request(const std::string &line, std::ostream &os, Local &local);
+
+private:
+  struct Entry {
+    Entry(double thr) : model(IslaModel::HadCM3L, thr) { }
+    std::mutex lock;            // Held while using the model.
+    IslaModel model;
+  };
+  typedef boost::shared_ptr<Entry> EntryPtr;
+
+  EntryPtr find(const std::string &file);
+  EntryPtr load(const std::string &file, const std::string &var);
+  const IslaModel &use(const std::string &file, Local &local,
+                       EntryPtr &e, std::unique_lock<std::mutex> &lock);
+  void connection(int fd);
+
+  std::string path;             // Socket path.
+  double threshold;             // Default island threshold.
+  int listenfd;                 // Listening socket.
+  std::atomic<bool> stopping;   // Shutdown requested?
+
+  std::map<std::string, EntryPtr> cache;
+  std::mutex cachelock;         // Protects cache.
+  std::mutex nclock;            // Serialises NetCDF access.
+
+  std::set<int> conns;          // Open connection sockets.
+  std::mutex connlock;          // Protects conns.
+  std::condition_variable conndone;     // Signalled as connections close.
+};
+
+#endif
@@ -0,0 +1,141 @@
+//----------------------------------------------------------------------
+// FILE:   IslandWriter.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Streaming writer for island data.
+//----------------------------------------------------------------------
+
+#include <ostream>
+#include <stdexcept>
+#include <cstring>
+using namespace std;
+
+#include "IslandWriter.hh"
+
+const char IslandWriter::MAGIC[4] = { 'I', 'S', 'L', 'B' };
+
+
+IslandWriter::IslandWriter(ostream &out, Format format) :
+  os(out), fmt(format), buf(BUFSIZE), used(0)
+{
+}
+
+// Anything still buffered is written out, but errors can't be
+// reported from here: call flush explicitly to check for them.
+
+IslandWriter::~IslandWriter()
+{
+  try { flush(); } catch (...) { }
+}
+
+void IslandWriter::flush(void)
+{
+  if (used > 0) os.write(&buf[0], used);
+  used = 0;
+  if (!os) throw runtime_error("Failed writing island data");
+}
+
+
+// Output primitives.
+
+void IslandWriter::put(const char *s, size_t n)
+{
+  while (n > 0) {
+    if (used == BUFSIZE) flush();
+    size_t k = min(n, BUFSIZE - used);
+    memcpy(&buf[used], s, k);
+    used += k;  s += k;  n -= k;
+  }
+}
+
+void IslandWriter::put(const char *s)
+{
+  put(s, strlen(s));
+}
+
+void IslandWriter::putInt(long val)
+{
+  char tmp[24];
+  int n = 0;
+  unsigned long v = val < 0 ? 0UL - val : val;
+  do { tmp[n++] = '0' + v % 10;  v /= 10; } while (v > 0);
+  if (val < 0) put('-');
+  while (n > 0) put(tmp[--n]);
+}
+
+void IslandWriter::putVarint(unsigned long val)
+{
+  while (val >= 0x80) {
+    put(static_cast<char>((val & 0x7F) | 0x80));
+    val >>= 7;
+  }
+  put(static_cast<char>(val));
+}
+
+
+// Header and islands.
+
+void IslandWriter::begin(size_t nislands)
+{
+  if (fmt == BINARY) {
+    put(MAGIC, sizeof(MAGIC));
+    putVarint(VERSION);
+    putVarint(nislands);
+  } else {
+    put("# Island file\n\n");
+    putInt(nislands);
+    put('\n');
+  }
+}
+
+void IslandWriter::island(const string &name, const vector<Rect> &segs)
+{
+  if (fmt == BINARY) {
+    putVarint(name.size());
+    put(name.data(), name.size());
+  } else {
+    put("\n# ");
+    put(name.data(), name.size());
+    put('\n');
+  }
+  segments(segs);
+}
+
+void IslandWriter::segments(const vector<Rect> &segs)
+{
+  if (fmt == BINARY) {
+    putVarint(segs.size());
+    for (vector<Rect>::const_iterator it = segs.begin();
+         it != segs.end(); ++it) {
+      if (it->x < 0 || it->y < 0 || it->width < 1 || it->height < 1)
+        throw domain_error("Invalid island segment");
+      putVarint(it->x);
+      putVarint(it->x + it->width - 1);
+      putVarint(it->y);
+      putVarint(it->y + it->height - 1);
+    }
+  } else {
+    putInt(segs.size());
+    put('\n');
+    for (int which = 0; which < 4; ++which) putBounds(segs, which);
+  }
+}
+
+// One line of ASCII segment bounds: start columns, end columns, start
+// rows or end rows.
+
+void IslandWriter::putBounds(const vector<Rect> &segs, int which)
+{
+  for (vector<Rect>::const_iterator it = segs.begin();
+       it != segs.end(); ++it) {
+    if (it != segs.begin()) put(' ');
+    switch (which) {
+    case 0: putInt(it->x);                      break;
+    case 1: putInt(it->x + it->width - 1);      break;
+    case 2: putInt(it->y);                      break;
+    default: putInt(it->y + it->height - 1);    break;
+    }
+  }
+  put('\n');
+}
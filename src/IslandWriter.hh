@@ -0,0 +1,70 @@
+//----------------------------------------------------------------------
+// FILE:   IslandWriter.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Streaming writer for island data.
+//
+// Output is formatted directly into a fixed-size buffer, which is
+// passed to the output stream in large blocks, so memory use doesn't
+// depend on the number or size of islands written.
+//
+// Two formats are supported: the usual ASCII island file layout
+// (island count, then for each island a name comment, a segment count
+// and lines of segment start and end columns and start and end rows)
+// and a compact binary equivalent.  Binary files start with the four
+// bytes "ISLB", then hold a format version, the island count and, for
+// each island, the name length and name bytes, the segment count and
+// the start and end column and start and end row of each segment in
+// turn.  All numbers are unsigned LEB128 variable-length integers.
+//----------------------------------------------------------------------
+
+#ifndef _H_ISLANDWRITER_
+#define _H_ISLANDWRITER_
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstddef>
+
+#include "Rect.hh"
+
+class IslandWriter {
+public:
+  enum Format { ASCII, BINARY };
+  static const char MAGIC[4];
+  static const unsigned int VERSION = 1;
+  static const std::size_t BUFSIZE = 1 << 16;
+
+  IslandWriter(std::ostream &os, Format fmt = ASCII);
+  ~IslandWriter();
+
+  // Write the file header, then each island.
+  void begin(std::size_t nislands);
+  void island(const std::string &name, const std::vector<Rect> &segs);
+
+  // Write just a segment list (ASCII: segment count and four lines of
+  // bounds).
+  void segments(const std::vector<Rect> &segs);
+
+  // Pass buffered output to the stream.
+  void flush(void);
+
+private:
+  IslandWriter(const IslandWriter &);
+  IslandWriter &operator=(const IslandWriter &);
+
+  void put(const char *s, std::size_t n);
+  void put(const char *s);
+  void put(char c) { if (used == BUFSIZE) flush();  buf[used++] = c; }
+  void putInt(long val);
+  void putVarint(unsigned long val);
+  void putBounds(const std::vector<Rect> &segs, int which);
+
+  std::ostream &os;
+  Format fmt;
+  std::vector<char> buf;
+  std::size_t used;
+};
+
+#endif
@@ -0,0 +1,95 @@
+//----------------------------------------------------------------------
+// FILE:   MappedFile.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// A whole file mapped into memory.
+//----------------------------------------------------------------------
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+#include "MappedFile.hh"
+
+
+MappedFile::MappedFile(string path, bool writable) :
+  fname(path), fd(-1), base(0), len(0), rw(writable)
+{
+  fd = open(path.c_str(), rw ? O_RDWR : O_RDONLY);
+  if (fd < 0)
+    throw runtime_error("Cannot open file: " + path + ": " + strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    string msg = strerror(errno);
+    close(fd);
+    throw runtime_error("Cannot read file: " + path + ": " + msg);
+  }
+  try {
+    map(st.st_size);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+}
+
+MappedFile::~MappedFile()
+{
+  unmap();
+  close(fd);
+}
+
+
+// Mappings default to random access (header fields, single fields
+// from large files), with read-ahead turned off.
+
+void MappedFile::map(size_t size)
+{
+  len = size;
+  if (len == 0) return;
+  void *p = mmap(0, len, rw ? PROT_READ | PROT_WRITE : PROT_READ,
+                 MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    base = 0;  len = 0;
+    throw runtime_error("Cannot map file: " + fname + ": " + strerror(errno));
+  }
+  base = static_cast<unsigned char *>(p);
+  madvise(p, len, MADV_RANDOM);
+}
+
+void MappedFile::unmap(void)
+{
+  if (base) munmap(base, len);
+  base = 0;
+}
+
+void MappedFile::adviseSequential(void)
+{
+  if (base) madvise(base, len, MADV_SEQUENTIAL);
+}
+
+void MappedFile::resize(size_t size)
+{
+  if (!rw)
+    throw runtime_error("File not opened for writing: " + fname);
+  size_t oldlen = len;
+  unmap();
+  if (ftruncate(fd, size) != 0) {
+    string msg = strerror(errno);
+    map(oldlen);
+    throw runtime_error("Cannot resize file: " + fname + ": " + msg);
+  }
+  map(size);
+}
+
+void MappedFile::sync(void)
+{
+  if (rw && base && msync(base, len, MS_SYNC) != 0)
+    throw runtime_error("Failed writing file: " + fname + ": " +
+                        strerror(errno));
+}
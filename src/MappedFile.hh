@@ -0,0 +1,53 @@
+//----------------------------------------------------------------------
+// FILE:   MappedFile.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// A whole file mapped into memory, read-only or shared read/write.
+// Writable mappings can be resized, which extends or truncates the
+// file and remaps it (so any pointers into the old mapping become
+// invalid).
+//----------------------------------------------------------------------
+
+#ifndef _H_MAPPEDFILE_
+#define _H_MAPPEDFILE_
+
+#include <string>
+#include <cstddef>
+
+class MappedFile {
+public:
+  MappedFile(std::string path, bool writable = false);
+  ~MappedFile();
+
+  std::string path(void) const { return fname; }
+  bool writable(void) const { return rw; }
+  std::size_t size(void) const { return len; }
+  const unsigned char *data(void) const { return base; }
+  unsigned char *data(void) { return base; }
+
+  // Mappings are set up for random access; a file that is going to
+  // be scanned from start to end should say so.
+  void adviseSequential(void);
+
+  // Change the file size (writable files only).
+  void resize(std::size_t size);
+
+  // Flush changes to disk.
+  void sync(void);
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  void map(std::size_t size);
+  void unmap(void);
+
+  std::string fname;
+  int fd;
+  unsigned char *base;          // Mapped file contents (null if empty).
+  std::size_t len;              // File length (bytes).
+  bool rw;                      // Opened for writing?
+};
+
+#endif
@@ -0,0 +1,128 @@
+//----------------------------------------------------------------------
+// FILE:   MaskPyramid.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Multi-resolution summary pyramid for land/sea and island masks.
+//----------------------------------------------------------------------
+
+#include <algorithm>
+using namespace std;
+
+#include "MaskPyramid.hh"
+
+
+// Build pyramid: level 0 from the masks, then each level from the
+// one below until there is a single cell.
+
+void MaskPyramid::build(const GridData<bool> &mask,
+                        const GridData<bool> &is_island)
+{
+  lvls.clear();
+  Level base;
+  base.nlat = mask.nlat();  base.nlon = mask.nlon();
+  base.data.resize(base.nlat * base.nlon);
+  for (int r = 0; r < base.nlat; ++r)
+    for (int c = 0; c < base.nlon; ++c) {
+      Summary &s = base.data[r * base.nlon + c];
+      s.n = 1;
+      s.land = mask(r, c) ? 1 : 0;
+      s.island = mask(r, c) && is_island(r, c) ? 1 : 0;
+    }
+  lvls.push_back(base);
+  while (lvls.back().nlat > 1 || lvls.back().nlon > 1) {
+    const Level &below = lvls.back();
+    Level l;
+    l.nlat = (below.nlat + 1) / 2;  l.nlon = (below.nlon + 1) / 2;
+    l.data.resize(l.nlat * l.nlon);
+    for (int r = 0; r < below.nlat; ++r)
+      for (int c = 0; c < below.nlon; ++c)
+        l.data[r / 2 * l.nlon + c / 2] += below.data[r * below.nlon + c];
+    lvls.push_back(l);
+  }
+}
+
+
+// Update a single grid cell, propagating the change up through all
+// levels.
+
+void MaskPyramid::update(int r, int c, bool land, bool island)
+{
+  if (lvls.empty()) return;
+  Summary &s = lvls[0].data[r * lvls[0].nlon + c];
+  int dland = (land ? 1 : 0) - s.land;
+  int disland = (land && island ? 1 : 0) - s.island;
+  if (dland == 0 && disland == 0) return;
+  for (unsigned int k = 0; k < lvls.size(); ++k, r /= 2, c /= 2) {
+    Summary &t = lvls[k].data[r * lvls[k].nlon + c];
+    t.land += dland;
+    t.island += disland;
+  }
+}
+
+
+// Choose pyramid level for a given number of grid cells per display
+// unit.
+
+int MaskPyramid::levelFor(double cells) const
+{
+  int level = 0;
+  while (level + 1 < levels() && (2 << level) <= cells) ++level;
+  return level;
+}
+
+
+// Box queries.
+
+MaskPyramid::Summary MaskPyramid::summarise(const Rect &box) const
+{
+  Summary acc;
+  if (!lvls.empty() && !box.IsEmpty())
+    query(levels() - 1, 0, 0, box, acc, STOP_NEVER);
+  return acc;
+}
+
+bool MaskPyramid::anyLand(const Rect &box) const
+{
+  Summary acc;
+  return !lvls.empty() && !box.IsEmpty() &&
+    query(levels() - 1, 0, 0, box, acc, STOP_LAND);
+}
+
+bool MaskPyramid::anyIsland(const Rect &box) const
+{
+  Summary acc;
+  return !lvls.empty() && !box.IsEmpty() &&
+    query(levels() - 1, 0, 0, box, acc, STOP_ISLAND);
+}
+
+bool MaskPyramid::query(int level, int r, int c, const Rect &box,
+                        Summary &acc, Stop stop) const
+{
+  const Summary &s = (*this)(level, r, c);
+  if ((stop == STOP_LAND && s.land == 0) ||
+      (stop == STOP_ISLAND && s.island == 0))
+    return false;
+
+  // Grid cell extent of this pyramid cell.
+  int c0 = c << level, r0 = r << level;
+  int c1 = min((c + 1) << level, nlon(0)) - 1;
+  int r1 = min((r + 1) << level, nlat(0)) - 1;
+  if (c1 < box.x || c0 > box.GetRight() || r1 < box.y || r0 > box.GetBottom())
+    return false;
+  if (c0 >= box.x && c1 <= box.GetRight() &&
+      r0 >= box.y && r1 <= box.GetBottom()) {
+    acc += s;
+    return stop != STOP_NEVER;
+  }
+
+  // Straddles the box edge: descend.
+  for (int dr = 0; dr < 2; ++dr)
+    for (int dc = 0; dc < 2; ++dc) {
+      int cr = 2 * r + dr, cc = 2 * c + dc;
+      if (cr < nlat(level - 1) && cc < nlon(level - 1) &&
+          query(level - 1, cr, cc, box, acc, stop))
+        return true;
+    }
+  return false;
+}
@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------
+// FILE:   MaskPyramid.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Multi-resolution summary pyramid for land/sea and island masks.
+// Level 0 has one entry per grid cell; each cell at level k + 1
+// summarises a 2x2 block of cells at level k (blocks at the top and
+// right edges may be smaller).  Each entry records the number of
+// grid cells it covers and how many of those are land and island,
+// which gives land fraction, any-land/any-island and dominant class
+// for any block.
+//
+// The pyramid is kept up to date incrementally: changing a single
+// grid cell only touches one entry per level.
+//----------------------------------------------------------------------
+
+#ifndef _H_MASKPYRAMID_
+#define _H_MASKPYRAMID_
+
+#include <vector>
+
+#include "GridData.hh"
+#include "Rect.hh"
+
+class MaskPyramid {
+public:
+  enum Class { OCEAN, LAND, ISLAND };
+
+  struct Summary {
+    Summary() : n(0), land(0), island(0) { }
+    unsigned int n;             // Number of grid cells covered.
+    unsigned int land;          // Number of land cells.
+    unsigned int island;        // Number of island cells.
+
+    double landFraction(void) const { return n > 0 ? double(land) / n : 0; }
+    Class dominant(void) const {
+      if (n - land >= land) return OCEAN;
+      return island > land - island ? ISLAND : LAND;
+    }
+    Summary &operator+=(const Summary &o) {
+      n += o.n;  land += o.land;  island += o.island;
+      return *this;
+    }
+  };
+
+  MaskPyramid() { }
+
+  // Build all levels from land/sea and island masks.  Cells count as
+  // island cells only if they're land.
+  void build(const GridData<bool> &mask, const GridData<bool> &is_island);
+
+  // Update a single grid cell.
+  void update(int r, int c, bool land, bool island);
+
+  // Pyramid dimensions.
+  int levels(void) const { return lvls.size(); }
+  int nlat(int level) const { return lvls[level].nlat; }
+  int nlon(int level) const { return lvls[level].nlon; }
+
+  // Summary for a single pyramid cell.
+  const Summary &operator()(int level, int r, int c) const {
+    const Level &l = lvls[level];
+    return l.data[r * l.nlon + c];
+  }
+
+  // Coarsest level whose cells are no bigger than a given number of
+  // grid cells across (e.g. the number of grid cells per pixel).
+  int levelFor(double cells) const;
+
+  // Box queries in grid cell coordinates (x = column, y = row; no
+  // longitude wraparound).  These only descend into pyramid cells
+  // that straddle the edge of the box.
+  Summary summarise(const Rect &box) const;
+  bool anyLand(const Rect &box) const;
+  bool anyIsland(const Rect &box) const;
+
+private:
+  struct Level {
+    int nlat, nlon;
+    std::vector<Summary> data;
+  };
+
+  // Recursive box query, optionally stopping as soon as any land or
+  // island cell is found.
+  enum Stop { STOP_NEVER, STOP_LAND, STOP_ISLAND };
+  bool query(int level, int r, int c, const Rect &box,
+             Summary &acc, Stop stop) const;
+
+  std::vector<Level> lvls;
+};
+
+#endif
@@ -0,0 +1,52 @@
+//----------------------------------------------------------------------
+// FILE:   MaskRuns.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Run-length encoding of the land/sea and island masks by grid row.
+//----------------------------------------------------------------------
+
+using namespace std;
+
+#include "MaskRuns.hh"
+
+
+void MaskRuns::build(const GridData<bool> &mask,
+                     const GridData<bool> &is_island)
+{
+  rows.clear();
+  rows.resize(mask.nlat());
+  for (int r = 0; r < mask.nlat(); ++r) updateRow(r, mask, is_island);
+}
+
+void MaskRuns::updateRow(int r, const GridData<bool> &mask,
+                         const GridData<bool> &is_island)
+{
+  Row &row = rows[r];
+  row.clear();
+  for (int c = 0; c < mask.nlon(); ++c) {
+    MaskPyramid::Class cls = !mask(r, c) ? MaskPyramid::OCEAN :
+      (is_island(r, c) ? MaskPyramid::ISLAND : MaskPyramid::LAND);
+    if (!row.empty() && row.back().cls == cls)
+      row.back().c1 = c + 1;
+    else {
+      Run run;
+      run.c0 = c;  run.c1 = c + 1;  run.cls = cls;
+      row.push_back(run);
+    }
+  }
+}
+
+
+// Binary search for the run containing a column.
+
+int MaskRuns::find(const Row &row, int c)
+{
+  int lo = 0, hi = row.size() - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (row[mid].c0 <= c) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
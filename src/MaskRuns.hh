@@ -0,0 +1,47 @@
+//----------------------------------------------------------------------
+// FILE:   MaskRuns.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Run-length encoding of the land/sea and island masks by grid row.
+// Each row is stored as a list of maximal runs of cells of the same
+// class (ocean, land or island), so that rendering at zoom levels
+// where cells are bigger than a pixel can fill whole runs at once
+// instead of classifying each cell.  Runs are kept up to date on
+// edits by re-encoding only the edited row.
+//----------------------------------------------------------------------
+
+#ifndef _H_MASKRUNS_
+#define _H_MASKRUNS_
+
+#include <vector>
+
+#include "GridData.hh"
+#include "MaskPyramid.hh"
+
+class MaskRuns {
+public:
+  struct Run {
+    int c0, c1;                 // Columns [c0, c1).
+    MaskPyramid::Class cls;
+  };
+  typedef std::vector<Run> Row;
+
+  MaskRuns() { }
+
+  // Encode all rows, or re-encode a single row after an edit.
+  void build(const GridData<bool> &mask, const GridData<bool> &is_island);
+  void updateRow(int r, const GridData<bool> &mask,
+                 const GridData<bool> &is_island);
+
+  int nlat(void) const { return rows.size(); }
+  const Row &row(int r) const { return rows[r]; }
+
+  // Index of the run containing a column.
+  static int find(const Row &row, int c);
+
+private:
+  std::vector<Row> rows;
+};
+
+#endif
@@ -0,0 +1,176 @@
+//----------------------------------------------------------------------
+// FILE:   OutlineIndex.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Spatial index over island outline elements.
+//----------------------------------------------------------------------
+
+#include <algorithm>
+using namespace std;
+
+#include "OutlineIndex.hh"
+
+
+// Split a possibly wrapping column range into at most two ordinary
+// ranges.  Returns the number of ranges.
+
+static int splitCols(int c0, int c1, int nlon, int cs[4])
+{
+  if (c0 <= c1) { cs[0] = c0;  cs[1] = c1;  return 1; }
+  cs[0] = c0;  cs[1] = nlon - 1;  cs[2] = 0;  cs[3] = c1;
+  return 2;
+}
+
+
+// Build index.
+
+void OutlineIndex::build(int nlon, int nlat,
+                         const map<LMass, IslaModel::IslandInfo> &isles)
+{
+  init(nlon, nlat);
+  for (map<LMass, IslaModel::IslandInfo>::const_iterator it = isles.begin();
+       it != isles.end(); ++it)
+    add(it->second);
+}
+
+void OutlineIndex::build(int nlon, int nlat,
+                         const vector<IslaModel::IslandInfo> &isles)
+{
+  init(nlon, nlat);
+  for (vector<IslaModel::IslandInfo>::const_iterator it = isles.begin();
+       it != isles.end(); ++it)
+    add(*it);
+}
+
+void OutlineIndex::clear(void)
+{
+  init(0, 0);
+}
+
+void OutlineIndex::init(int nlon_in, int nlat_in)
+{
+  nlon = nlon_in;  nlat = nlat_in;
+  nbx = (nlon + BIN - 1) / BIN;  nby = (nlat + BIN - 1) / BIN;
+  items.clear();
+  bins.clear();
+  bins.resize(nbx * nby);
+  seen.clear();
+  stamp = 0;
+}
+
+void OutlineIndex::add(const IslaModel::IslandInfo &isl)
+{
+  Item it;
+  it.kind = SEGMENT;
+  it.pos = it.lo = it.hi = 0;
+  for (vector<Rect>::const_iterator s = isl.segments.begin();
+       s != isl.segments.end(); ++s) {
+    it.seg = *s;
+    insert(it);
+  }
+  it.seg = Rect();
+  it.kind = VCOINC;
+  for (IslaModel::CoincInfo::const_iterator v = isl.vcoinc.begin();
+       v != isl.vcoinc.end(); ++v) {
+    it.pos = v->first;  it.lo = v->second.first;  it.hi = v->second.second;
+    insert(it);
+  }
+  it.kind = HCOINC;
+  for (IslaModel::CoincInfo::const_iterator h = isl.hcoinc.begin();
+       h != isl.hcoinc.end(); ++h) {
+    it.pos = h->first;  it.lo = h->second.first;  it.hi = h->second.second;
+    insert(it);
+  }
+}
+
+
+// Add an element to every bin its extent overlaps.
+
+void OutlineIndex::insert(const Item &it)
+{
+  int idx = items.size();
+  items.push_back(it);
+  int c0, c1, r0, r1, cs[4];
+  extent(it, c0, c1, r0, r1);
+  int n = splitCols(c0, c1, nlon, cs);
+  for (int br = r0 / BIN; br <= r1 / BIN; ++br)
+    for (int i = 0; i < n; ++i)
+      for (int bc = cs[2*i] / BIN; bc <= cs[2*i+1] / BIN; ++bc)
+        bins[br * nbx + bc].push_back(idx);
+}
+
+
+// Element extent.  Segment outlines are drawn between the centres of
+// their first and last cells, and hatching is one cell wide centred
+// on the coincident line, so padding by one cell all round is
+// enough.
+
+void OutlineIndex::extent(const Item &it,
+                          int &c0, int &c1, int &r0, int &r1) const
+{
+  int cstart, ncols;
+  switch (it.kind) {
+  case SEGMENT:
+    cstart = it.seg.x - 2;  ncols = it.seg.width + 3;
+    r0 = it.seg.y - 2;  r1 = it.seg.y + it.seg.height;
+    break;
+  case VCOINC:
+    cstart = it.pos - 2;  ncols = 3;
+    r0 = it.lo - 2;  r1 = it.hi;
+    break;
+  default:
+    cstart = it.lo - 2;
+    ncols = ((it.hi - it.lo) % nlon + nlon) % nlon + 3;
+    r0 = it.pos - 2;  r1 = it.pos;
+    break;
+  }
+  r0 = max(0, r0);  r1 = min(nlat - 1, r1);
+  if (ncols >= nlon) { c0 = 0;  c1 = nlon - 1;  return; }
+  c0 = (cstart % nlon + nlon) % nlon;
+  c1 = (c0 + ncols - 1) % nlon;
+}
+
+
+// Box query: collect candidate elements from the bins overlapped by
+// the box (marking each one so that elements in several bins are
+// only considered once), then check their exact extents.
+
+void OutlineIndex::query(int c0, int c1, int r0, int r1,
+                         vector<const Item *> &res) const
+{
+  res.clear();
+  if (items.empty()) return;
+  r0 = max(0, r0);  r1 = min(nlat - 1, r1);
+  if (r0 > r1) return;
+  if (seen.size() != items.size() || ++stamp == 0) {
+    seen.assign(items.size(), 0);
+    stamp = 1;
+  }
+  int qcs[4], ecs[4];
+  int nq = splitCols(c0, c1, nlon, qcs);
+  vector<int> found;
+  for (int br = r0 / BIN; br <= r1 / BIN; ++br)
+    for (int i = 0; i < nq; ++i)
+      for (int bc = qcs[2*i] / BIN; bc <= qcs[2*i+1] / BIN; ++bc) {
+        const vector<int> &bin = bins[br * nbx + bc];
+        for (vector<int>::const_iterator it = bin.begin();
+             it != bin.end(); ++it) {
+          if (seen[*it] == stamp) continue;
+          seen[*it] = stamp;
+          int ec0, ec1, er0, er1;
+          extent(items[*it], ec0, ec1, er0, er1);
+          if (er1 < r0 || er0 > r1) continue;
+          int ne = splitCols(ec0, ec1, nlon, ecs);
+          bool hit = false;
+          for (int j = 0; j < nq && !hit; ++j)
+            for (int k = 0; k < ne && !hit; ++k)
+              hit = qcs[2*j] <= ecs[2*k+1] && ecs[2*k] <= qcs[2*j+1];
+          if (hit) found.push_back(*it);
+        }
+      }
+  sort(found.begin(), found.end());
+  for (vector<int>::const_iterator it = found.begin();
+       it != found.end(); ++it)
+    res.push_back(&items[*it]);
+}
@@ -0,0 +1,79 @@
+//----------------------------------------------------------------------
+// FILE:   OutlineIndex.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Spatial index over island outline elements (segment rectangles and
+// vertical and horizontal coincidence hatching) in grid cell
+// coordinates, used to draw only the outlines that intersect the
+// current view.
+//
+// Elements are binned into a uniform grid of square bins, each
+// covering BIN x BIN grid cells.  Each element is entered in every
+// bin overlapped by its (slightly padded) extent, and box queries
+// visit only the bins overlapped by the box.  Boxes and element
+// extents may wrap around in longitude.
+//----------------------------------------------------------------------
+
+#ifndef _H_OUTLINEINDEX_
+#define _H_OUTLINEINDEX_
+
+#include <vector>
+#include <map>
+
+#include "IslaModel.hh"
+
+class OutlineIndex {
+public:
+  static const int BIN = 8;     // Bin size (grid cells).
+
+  enum Kind { SEGMENT, VCOINC, HCOINC };
+
+  // A single outline element, with the same (1-based) coordinates as
+  // in IslandInfo.  Segments use seg; coincidence entries use pos
+  // (column for vertical, row for horizontal hatching) and the range
+  // [lo, hi] along the other axis.
+  struct Item {
+    Kind kind;
+    Rect seg;
+    int pos, lo, hi;
+  };
+
+  OutlineIndex() : nlon(0), nlat(0), nbx(0), nby(0), stamp(0) { }
+
+  // Rebuild from model islands or from a list of (comparison)
+  // islands.
+  void build(int nlon, int nlat,
+             const std::map<LMass, IslaModel::IslandInfo> &isles);
+  void build(int nlon, int nlat,
+             const std::vector<IslaModel::IslandInfo> &isles);
+  void clear(void);
+
+  // Find elements overlapping a box of grid cells: columns c0 to c1
+  // (wrapping round if c1 < c0) and rows r0 to r1 (0-based,
+  // inclusive).  Results are returned in insertion order, i.e. island
+  // by island.
+  void query(int c0, int c1, int r0, int r1,
+             std::vector<const Item *> &res) const;
+
+  int size(void) const { return items.size(); }
+  const Item &item(int i) const { return items[i]; }
+
+  // Extent of an element in 0-based grid cells, padded by one cell
+  // to allow for outline pen width.  Columns may wrap (c1 < c0).
+  void extent(const Item &it, int &c0, int &c1, int &r0, int &r1) const;
+
+private:
+  void init(int nlon, int nlat);
+  void add(const IslaModel::IslandInfo &isl);
+  void insert(const Item &it);
+
+  int nlon, nlat;               // Grid size.
+  int nbx, nby;                 // Bin grid size.
+  std::vector<Item> items;
+  std::vector<std::vector<int> > bins;
+  mutable std::vector<unsigned int> seen;
+  mutable unsigned int stamp;
+};
+
+#endif
@@ -0,0 +1,55 @@
+//----------------------------------------------------------------------
+// FILE:   Rect.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Integer rectangle type used for island segments and landmass
+// bounding boxes.  This replaces wxRect in the core model code so
+// that the model can be built without wxWidgets.  The interface
+// follows the parts of wxRect that the model code uses.
+//----------------------------------------------------------------------
+
+#ifndef _H_RECT_
+#define _H_RECT_
+
+#include <algorithm>
+
+struct Rect {
+  Rect() : x(0), y(0), width(0), height(0) { }
+  Rect(int ix, int iy, int iw, int ih) :
+    x(ix), y(iy), width(iw), height(ih) { }
+
+  bool IsEmpty(void) const { return width <= 0 || height <= 0; }
+  int GetRight(void) const { return x + width - 1; }
+  int GetBottom(void) const { return y + height - 1; }
+
+  bool Contains(int px, int py) const {
+    return px >= x && px < x + width && py >= y && py < y + height;
+  }
+
+  // Extend to the smallest rectangle containing both rectangles.
+  Rect &Union(const Rect &r) {
+    if (r.IsEmpty()) return *this;
+    if (IsEmpty()) { *this = r;  return *this; }
+    int x1 = std::max(x + width, r.x + r.width);
+    int y1 = std::max(y + height, r.y + r.height);
+    x = std::min(x, r.x);  y = std::min(y, r.y);
+    width = x1 - x;  height = y1 - y;
+    return *this;
+  }
+
+  // Do two rectangles have any cells in common?
+  bool Intersects(const Rect &r) const {
+    return std::max(x, r.x) < std::min(x + width, r.x + r.width) &&
+      std::max(y, r.y) < std::min(y + height, r.y + r.height);
+  }
+
+  bool operator==(const Rect &r) const {
+    return x == r.x && y == r.y && width == r.width && height == r.height;
+  }
+  bool operator!=(const Rect &r) const { return !(*this == r); }
+
+  int x, y, width, height;
+};
+
+#endif
@@ -0,0 +1,132 @@
+//----------------------------------------------------------------------
+// FILE:   Regrid.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Conservative area-weighted regridding between latitude/longitude
+// grids.
+//----------------------------------------------------------------------
+
+#include <map>
+#include <mutex>
+#include <cmath>
+using namespace std;
+
+#include "Regrid.hh"
+
+// Radius of Earth in km (as used by Grid::cellArea).
+static const double REARTH = 6370.0;
+
+static const double DEG = M_PI / 180.0;
+
+
+// Cell edges from cell centres: half way between centres, with the
+// outer edges half a cell beyond the outer centres.  Latitude edges
+// are clamped to the poles.
+
+static void cellEdges(const vector<double> &ctrs, bool lat,
+                      vector<double> &edges)
+{
+  size_t n = ctrs.size();
+  edges.resize(n + 1);
+  for (size_t i = 1; i < n; ++i) edges[i] = (ctrs[i - 1] + ctrs[i]) / 2;
+  edges[0] = ctrs[0] - (ctrs[1] - ctrs[0]) / 2;
+  edges[n] = ctrs[n - 1] + (ctrs[n - 1] - ctrs[n - 2]) / 2;
+  if (lat) {
+    edges[0] = max(edges[0], -90.0);
+    edges[n] = min(edges[n], 90.0);
+  }
+}
+
+
+// Overlap tables along one dimension.  Latitude overlaps are given
+// as R^2 (sin lat1 - sin lat0); longitude overlaps are in radians and
+// take account of periodicity.
+
+static void overlaps(const vector<double> &src, const vector<double> &dst,
+                     bool lat, RegridWeights::Overlaps &ov)
+{
+  vector<double> se, de;
+  cellEdges(src, lat, se);
+  cellEdges(dst, lat, de);
+  ov.start.assign(1, 0);
+  ov.src.clear();
+  ov.wt.clear();
+  for (size_t i = 0; i + 1 < de.size(); ++i) {
+    for (size_t k = 0; k + 1 < se.size(); ++k) {
+      double w = 0.0;
+      if (lat) {
+        double lo = max(se[k], de[i]), hi = min(se[k + 1], de[i + 1]);
+        if (hi > lo)
+          w = REARTH * REARTH * (sin(hi * DEG) - sin(lo * DEG));
+      } else {
+        for (int shift = -360; shift <= 360; shift += 360) {
+          double lo = max(se[k] + shift, de[i]);
+          double hi = min(se[k + 1] + shift, de[i + 1]);
+          if (hi > lo) w += (hi - lo) * DEG;
+        }
+      }
+      if (w > 0.0) {
+        ov.src.push_back(k);
+        ov.wt.push_back(w);
+      }
+    }
+    ov.start.push_back(ov.src.size());
+  }
+}
+
+RegridWeights::RegridWeights(const Grid &from, const Grid &to) :
+  snlat(from.nlat()), snlon(from.nlon())
+{
+  if (from.nlat() < 2 || from.nlon() < 2 || to.nlat() < 2 || to.nlon() < 2)
+    throw domain_error("Regridding needs at least two latitudes and "
+                       "longitudes");
+  overlaps(from.lats(), to.lats(), true, rowov);
+  overlaps(from.lons(), to.lons(), false, colov);
+}
+
+
+// Weights cache, keyed by source and destination grid coordinates.
+
+typedef pair< vector<double>, vector<double> > GridKey;
+typedef map< pair<GridKey, GridKey>, RegridWeights::Ptr > WeightsCache;
+static WeightsCache cache;
+static mutex cachelock;
+
+RegridWeights::Ptr RegridWeights::get(GridPtr from, GridPtr to)
+{
+  pair<GridKey, GridKey> key(GridKey(from->lats(), from->lons()),
+                             GridKey(to->lats(), to->lons()));
+  {
+    lock_guard<mutex> lock(cachelock);
+    WeightsCache::const_iterator it = cache.find(key);
+    if (it != cache.end()) return it->second;
+  }
+
+  // Calculate outside the lock: two threads may occasionally both
+  // calculate the same weights, but the first result is kept.
+  Ptr w(new RegridWeights(*from, *to));
+  lock_guard<mutex> lock(cachelock);
+  return cache.insert(make_pair(key, w)).first->second;
+}
+
+void RegridWeights::clearCache(void)
+{
+  lock_guard<mutex> lock(cachelock);
+  cache.clear();
+}
+
+
+// Overlapping source cells and areas for a destination cell.
+
+void RegridWeights::cell(int r, int c, vector<size_t> &idx,
+                         vector<double> &ws) const
+{
+  idx.clear();
+  ws.clear();
+  for (size_t i = rowov.start[r]; i < rowov.start[r + 1]; ++i)
+    for (size_t j = colov.start[c]; j < colov.start[c + 1]; ++j) {
+      idx.push_back(static_cast<size_t>(rowov.src[i]) * snlon + colov.src[j]);
+      ws.push_back(rowov.wt[i] * colov.wt[j]);
+    }
+}
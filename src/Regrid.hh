@@ -0,0 +1,207 @@
+//----------------------------------------------------------------------
+// FILE:   Regrid.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Conservative area-weighted regridding between latitude/longitude
+// grids.
+//
+// Grid cells are bounded by lines of latitude and longitude, with
+// edges half way between cell centres (outer latitude edges are
+// clamped to the poles, as in Grid::cellArea).  The overlap of a
+// source and a destination cell is then itself a latitude/longitude
+// rectangle, whose exact spherical area R^2 (lon1 - lon0) (sin lat1 -
+// sin lat0) is a product of a latitude factor and a longitude factor.
+// The weights for a pair of grids are therefore held as two sparse
+// one-dimensional overlap tables, for rows and for columns, and the
+// weight of a source cell in a destination cell is the product of its
+// row and column entries.  This is exact, and much smaller than a
+// table of two-dimensional weights for high-resolution sources.
+//
+// Weights are calculated once for each pair of grids and cached (by
+// grid coordinates, not grid object).  Fields are regridded by
+// applying a reduction functor to the source values and overlap
+// areas for each destination cell, with destination rows split
+// between threads.
+//----------------------------------------------------------------------
+
+#ifndef _H_REGRID_
+#define _H_REGRID_
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstddef>
+#include <boost/shared_ptr.hpp>
+
+#include "Grid.hh"
+#include "GridData.hh"
+
+class RegridWeights {
+public:
+  typedef boost::shared_ptr<const RegridWeights> Ptr;
+
+  RegridWeights(const Grid &from, const Grid &to);
+
+  // Cached weights for a pair of grids.  Safe to call from multiple
+  // threads.
+  static Ptr get(GridPtr from, GridPtr to);
+  static void clearCache(void);
+
+  // Sparse overlaps along one dimension: for destination index i,
+  // entries start[i] to start[i+1]-1 of src and wt give the
+  // overlapping source indexes and overlap factors (km^2 per radian
+  // of longitude for rows, radians for columns).
+  struct Overlaps {
+    std::vector<std::size_t> start;
+    std::vector<int> src;
+    std::vector<double> wt;
+  };
+  const Overlaps &rows(void) const { return rowov; }
+  const Overlaps &cols(void) const { return colov; }
+
+  int srcNlat(void) const { return snlat; }
+  int srcNlon(void) const { return snlon; }
+  int dstNlat(void) const { return rowov.start.size() - 1; }
+  int dstNlon(void) const { return colov.start.size() - 1; }
+
+  // Source cells (flat indexes) overlapping a destination cell, and
+  // their overlap areas (km^2).
+  void cell(int r, int c, std::vector<std::size_t> &idx,
+            std::vector<double> &ws) const;
+
+  // Regrid a field: to(r, c) = fn(xs, ws), where xs are the values of
+  // the non-missing source cells overlapping destination cell (r, c)
+  // and ws their overlap areas.  Cells with no overlapping values are
+  // left unchanged.  Rows are split between nthreads threads (0 =>
+  // one per core).
+  template<typename T, typename R, typename F>
+  void apply(const GridData<T> &from, GridData<R> &to, F fn,
+             unsigned int nthreads = 0) const;
+
+private:
+  template<typename T, typename R, typename F>
+  void applyRows(const GridData<T> *from, int r0, int r1, F fn,
+                 std::vector<R> *res, std::vector<char> *set) const;
+
+  int snlat, snlon;
+  Overlaps rowov, colov;
+};
+
+
+// Standard reductions.
+
+// Area-weighted mean.
+struct WeightedMean {
+  template<typename T>
+  double operator()(const std::vector<T> &xs,
+                    const std::vector<double> &ws) const {
+    double x = 0.0, w = 0.0;
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+      x += xs[i] * ws[i];  w += ws[i];
+    }
+    return w > 0.0 ? x / w : 0.0;
+  }
+};
+
+// Fraction of area where the source value is non-zero (land
+// fraction for a land/sea mask).
+struct LandFraction {
+  template<typename T>
+  double operator()(const std::vector<T> &xs,
+                    const std::vector<double> &ws) const {
+    double land = 0.0, w = 0.0;
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+      if (xs[i]) land += ws[i];
+      w += ws[i];
+    }
+    return w > 0.0 ? land / w : 0.0;
+  }
+};
+
+// Mask from land fraction (for masks) or area-weighted mean (for
+// fractional fields) exceeding a threshold.
+struct Majority {
+  Majority(double thr = 0.5) : thresh(thr) { }
+  double thresh;
+  template<typename T>
+  bool operator()(const std::vector<T> &xs,
+                  const std::vector<double> &ws) const {
+    return WeightedMean()(xs, ws) > thresh;
+  }
+  bool operator()(const std::vector<bool> &xs,
+                  const std::vector<double> &ws) const {
+    return LandFraction()(xs, ws) > thresh;
+  }
+};
+
+
+// Regrid a field using cached weights.
+
+template<typename T, typename R, typename F>
+void regrid(const GridData<T> &from, GridData<R> &to, F fn,
+            unsigned int nthreads = 0)
+{
+  RegridWeights::get(from.grid(), to.grid())->apply(from, to, fn, nthreads);
+}
+
+
+// Template implementation.  Each thread fills its own result block,
+// which is copied into the destination field afterwards, so threads
+// never write to shared storage (GridData<bool> is bit-packed).
+
+template<typename T, typename R, typename F>
+void RegridWeights::apply(const GridData<T> &from, GridData<R> &to, F fn,
+                          unsigned int nthreads) const
+{
+  if (from.nlat() != snlat || from.nlon() != snlon ||
+      to.nlat() != dstNlat() || to.nlon() != dstNlon())
+    throw std::domain_error("grid mismatch in RegridWeights::apply");
+  if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+  nthreads = std::max(1U, std::min(nthreads,
+                                   static_cast<unsigned int>(to.nlat())));
+  int nlat = to.nlat(), nlon = to.nlon();
+  std::vector< std::vector<R> > res(nthreads);
+  std::vector< std::vector<char> > set(nthreads);
+  std::vector<int> r0(nthreads + 1);
+  for (unsigned int t = 0; t <= nthreads; ++t)
+    r0[t] = static_cast<long>(nlat) * t / nthreads;
+  std::vector<std::thread> ts;
+  for (unsigned int t = 1; t < nthreads; ++t)
+    ts.push_back(std::thread(&RegridWeights::applyRows<T, R, F>, this,
+                             &from, r0[t], r0[t + 1], fn, &res[t], &set[t]));
+  applyRows<T, R, F>(&from, r0[0], r0[1], fn, &res[0], &set[0]);
+  for (std::size_t t = 0; t < ts.size(); ++t) ts[t].join();
+  for (unsigned int t = 0; t < nthreads; ++t)
+    for (int r = r0[t], i = 0; r < r0[t + 1]; ++r)
+      for (int c = 0; c < nlon; ++c, ++i)
+        if (set[t][i]) to(r, c) = res[t][i];
+}
+
+template<typename T, typename R, typename F>
+void RegridWeights::applyRows(const GridData<T> *from, int r0, int r1,
+                              F fn, std::vector<R> *res,
+                              std::vector<char> *set) const
+{
+  int nlon = dstNlon();
+  res->resize(static_cast<std::size_t>(r1 - r0) * nlon);
+  set->assign(res->size(), 0);
+  std::vector<std::size_t> idx;
+  std::vector<double> ws, vws;
+  std::vector<T> xs;
+  for (int r = r0, i = 0; r < r1; ++r)
+    for (int c = 0; c < nlon; ++c, ++i) {
+      cell(r, c, idx, ws);
+      xs.clear();  vws.clear();
+      for (std::size_t k = 0; k < idx.size(); ++k) {
+        T x = from->data()[idx[k]];
+        if (from->is_missing(x)) continue;
+        xs.push_back(x);  vws.push_back(ws[k]);
+      }
+      if (xs.empty()) continue;
+      (*res)[i] = fn(xs, vws);
+      (*set)[i] = 1;
+    }
+}
+
+#endif
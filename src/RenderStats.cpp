@@ -0,0 +1,80 @@
+//----------------------------------------------------------------------
+// FILE:   RenderStats.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Frame timing and work counters for map rendering.
+//----------------------------------------------------------------------
+
+using namespace std;
+
+#include "RenderStats.hh"
+
+const double RenderStats::BUCKETS[NBUCKETS - 1] =
+  { 1.0, 2.0, 4.0, 8.0, 16.7, 33.3, 66.7 };
+
+const char *RenderStats::phaseName(int p)
+{
+  static const char *names[NPHASES] =
+    { "cells", "grid", "islands", "comparison", "axes", "composite" };
+  return p >= 0 && p < NPHASES ? names[p] : "";
+}
+
+RenderStats::Frame::Frame() : total(0), drawcalls(0), cells(0)
+{
+  for (int p = 0; p < NPHASES; ++p) t[p] = 0;
+}
+
+RenderStats::RenderStats(unsigned int w) : nwindow(w), nframe(0) { }
+
+
+// Finish the current frame: total up phase times, add to the rolling
+// window and write trace output.
+
+void RenderStats::endFrame(void)
+{
+  cur.total = 0;
+  for (int p = 0; p < NPHASES; ++p) cur.total += cur.t[p];
+  window.push_back(cur.total);
+  while (window.size() > nwindow) window.pop_front();
+  if (trace.is_open()) {
+    trace << nframe;
+    for (int p = 0; p < NPHASES; ++p) trace << "," << cur.t[p];
+    trace << "," << cur.total << "," << cur.drawcalls
+          << "," << cur.cells << "\n";
+  }
+  ++nframe;
+  lastframe = cur;
+  cur = Frame();
+}
+
+
+void RenderStats::histogram(vector<int> &counts) const
+{
+  counts.assign(NBUCKETS, 0);
+  for (deque<double>::const_iterator it = window.begin();
+       it != window.end(); ++it) {
+    int b = 0;
+    while (b < NBUCKETS - 1 && *it > BUCKETS[b]) ++b;
+    ++counts[b];
+  }
+}
+
+
+// Trace files start with a header line naming the columns.
+
+bool RenderStats::startTrace(const string &file)
+{
+  stopTrace();
+  trace.open(file.c_str());
+  if (!trace) return false;
+  trace << "frame";
+  for (int p = 0; p < NPHASES; ++p) trace << "," << phaseName(p);
+  trace << ",total,drawcalls,cells\n";
+  return true;
+}
+
+void RenderStats::stopTrace(void)
+{
+  if (trace.is_open()) trace.close();
+}
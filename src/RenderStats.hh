@@ -0,0 +1,90 @@
+//----------------------------------------------------------------------
+// FILE:   RenderStats.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Frame timing and work counters for map rendering.
+//
+// Rendering work is accumulated into the current frame as it
+// happens (layer re-rendering during paints, but also strips
+// rendered while panning, tiles arriving from the tile cache and
+// cell edits), split by phase, together with counts of draw calls
+// and grid cells visited.  Each paint ends the current frame, which
+// is added to a rolling window of recent frames used for a
+// frame-time histogram and optionally written to a trace file.
+//----------------------------------------------------------------------
+
+#ifndef _H_RENDERSTATS_
+#define _H_RENDERSTATS_
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <fstream>
+#include <chrono>
+
+class RenderStats {
+public:
+  // Phases: the first five match the canvas rendering layers.
+  enum Phase { CELLS, GRID, ISLANDS, COMPARISON, AXES, COMPOSITE,
+               NPHASES };
+  static const char *phaseName(int p);
+
+  struct Frame {
+    Frame();
+    double t[NPHASES];          // Time per phase (ms).
+    double total;               // Total time (ms).
+    unsigned long drawcalls;    // Number of drawing calls.
+    unsigned long cells;        // Number of grid cells visited.
+  };
+
+  // Histogram bucket upper bounds (ms); the last bucket is open.
+  static const int NBUCKETS = 8;
+  static const double BUCKETS[NBUCKETS - 1];
+
+  RenderStats(unsigned int window = 120);
+  ~RenderStats() { stopTrace(); }
+
+  // Time a phase of the current frame for the lifetime of the
+  // object.
+  class Timer {
+  public:
+    Timer(RenderStats &s, int p) :
+      stats(s), phase(p), start(std::chrono::steady_clock::now()) { }
+    ~Timer() {
+      std::chrono::duration<double, std::milli> d =
+        std::chrono::steady_clock::now() - start;
+      stats.cur.t[phase] += d.count();
+    }
+  private:
+    RenderStats &stats;
+    int phase;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  void drawCalls(unsigned long n) { cur.drawcalls += n; }
+  void cellsVisited(unsigned long n) { cur.cells += n; }
+
+  // Finish the current frame.
+  void endFrame(void);
+
+  // Most recently finished frame and frame-time histogram over the
+  // rolling window.
+  const Frame &last(void) const { return lastframe; }
+  void histogram(std::vector<int> &counts) const;
+  int frames(void) const { return window.size(); }
+
+  // Write one line per frame to a trace file (CSV).
+  bool startTrace(const std::string &file);
+  void stopTrace(void);
+  bool tracing(void) const { return trace.is_open(); }
+
+private:
+  Frame cur, lastframe;
+  unsigned int nwindow;
+  std::deque<double> window;    // Recent frame totals (ms).
+  std::ofstream trace;
+  unsigned long nframe;
+};
+
+#endif
@@ -0,0 +1,99 @@
+//----------------------------------------------------------------------
+// FILE:   SessionFile.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Fixed-layout binary session files.
+//----------------------------------------------------------------------
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+using namespace std;
+
+#include "SessionFile.hh"
+
+const char SessionFile::MAGIC[4] = { 'I', 'S', 'L', 'S' };
+
+// Sections start on 8-byte boundaries.
+
+static uint64_t align(uint64_t off) { return (off + 7) & ~uint64_t(7); }
+
+
+bool SessionFile::isSessionFile(string path)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) return false;
+  char magic[4];
+  size_t n = fread(magic, 1, sizeof(magic), fp);
+  fclose(fp);
+  return n == sizeof(magic) && memcmp(magic, MAGIC, sizeof(magic)) == 0;
+}
+
+
+// Lay out the sections after the header, then write the header and
+// each section in turn, zero-padded to the next section's offset.
+
+void SessionFile::write(string path, Header &hdr,
+                        const void *const data[NSECTIONS])
+{
+  memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+  hdr.version = VERSION;
+  hdr.byte_order = ORDER_MARK;
+  uint64_t off = align(sizeof(Header));
+  for (int s = 0; s < NSECTIONS; ++s) {
+    hdr.offset[s] = off;
+    off = align(off + hdr.length[s]);
+  }
+
+  ofstream os(path.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!os) throw runtime_error("Cannot create session file: " + path);
+  const char zeros[8] = { 0 };
+  os.write(reinterpret_cast<const char *>(&hdr), sizeof(Header));
+  uint64_t pos = sizeof(Header);
+  for (int s = 0; s < NSECTIONS; ++s) {
+    os.write(zeros, hdr.offset[s] - pos);
+    if (hdr.length[s] > 0)
+      os.write(static_cast<const char *>(data[s]), hdr.length[s]);
+    pos = hdr.offset[s] + hdr.length[s];
+  }
+  os.write(zeros, off - pos);
+  os.close();
+  if (!os) throw runtime_error("Failed writing session file: " + path);
+}
+
+
+// Map a session file and check the header and section table.
+
+SessionFile::SessionFile(string path) : file(path), hdr(0)
+{
+  if (file.size() < sizeof(Header) ||
+      memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0)
+    throw runtime_error("Not an Isla session file: " + path);
+  hdr = reinterpret_cast<const Header *>(file.data());
+  if (hdr->version != VERSION)
+    throw runtime_error("Unsupported session file version: " + path);
+  if (hdr->byte_order != ORDER_MARK)
+    throw runtime_error("Session file has wrong byte order: " + path);
+  for (int s = 0; s < NSECTIONS; ++s)
+    if (hdr->offset[s] % 8 != 0 || hdr->offset[s] < sizeof(Header) ||
+        hdr->offset[s] > file.size() ||
+        hdr->length[s] > file.size() - hdr->offset[s])
+      throw runtime_error("Corrupt session file: " + path);
+  file.adviseSequential();
+}
+
+void SessionFile::check(Section s, size_t len) const
+{
+  if (hdr->length[s] != len)
+    throw runtime_error("Corrupt session file: " + file.path());
+}
+
+string SessionFile::str(uint32_t off, uint32_t len) const
+{
+  if (off > hdr->length[STRINGS] || len > hdr->length[STRINGS] - off)
+    throw runtime_error("Corrupt session file: " + file.path());
+  return string(reinterpret_cast<const char *>(file.data()) +
+                hdr->offset[STRINGS] + off, len);
+}
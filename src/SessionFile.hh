@@ -0,0 +1,129 @@
+//----------------------------------------------------------------------
+// FILE:   SessionFile.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Fixed-layout binary session files.
+//
+// A session file holds everything needed to restore an editing
+// session: the grid, the original and current masks, the derived
+// landmass, ISMASK and island fields, landmass bounding boxes and
+// areas, the islands with their segmentations and levels of detail,
+// and any comparison islands.
+//
+// The file is a header followed by a fixed sequence of sections.  The
+// header gives the format version, the grid and island counts and the
+// byte offset and length of each section; sections start on 8-byte
+// boundaries and hold plain arrays of fixed-size values in the byte
+// order of the machine that wrote the file.  Reading a session maps
+// the file and copies each section straight out of the mapping, with
+// no parsing and no recalculation.  Files written on a machine with
+// the other byte order are rejected.
+//----------------------------------------------------------------------
+
+#ifndef _H_SESSIONFILE_
+#define _H_SESSIONFILE_
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+#include "MappedFile.hh"
+
+class SessionFile {
+public:
+  static const char MAGIC[4];
+  static const uint32_t VERSION = 1;
+  static const uint32_t ORDER_MARK = 0x01020304;
+
+  // Sections, in file order, with their element types.
+  enum Section {
+    LATS,                       // double[nlat]
+    LONS,                       // double[nlon]
+    ORIG_MASK,                  // uint8_t[nlat * nlon]
+    MASK,                       // uint8_t[nlat * nlon]
+    LANDMASS,                   // uint32_t[nlat * nlon]
+    ISMASK,                     // uint8_t[nlat * nlon]
+    IS_ISLAND,                  // uint8_t[nlat * nlon]
+    LMBBOX,                     // BBoxRecord[nlandmass]
+    LMSIZES,                    // double[nlandmass + 1]
+    LMCOUNTS,                   // int32_t[nlandmass + 1]
+    ISLANDS,                    // IslandRecord[nisles]
+    SEGMENTS,                   // SegmentRecord[total island segments]
+    COMP_ISLANDS,               // IslandRecord[ncomp]
+    COMP_SEGMENTS,              // SegmentRecord[total comparison segments]
+    STRINGS,                    // char[]: file names, island names
+    NSECTIONS
+  };
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t gridtype;          // IslaModel::GridType.
+    double threshold;           // Island area threshold (km^2).
+    uint32_t nlat, nlon;
+    uint32_t nlandmass;
+    uint32_t nisles, ncomp;
+    int32_t grid_changes;
+    uint32_t maskfile, maskfile_len;    // Offsets into STRINGS.
+    uint32_t maskvar, maskvar_len;
+    uint64_t offset[NSECTIONS];
+    uint64_t length[NSECTIONS];
+  };
+
+  // Landmass bounding boxes: x, y, width, height of each rectangle.
+  struct BBoxRecord {
+    int32_t both;
+    int32_t b1[4], b2[4];
+  };
+
+  // Islands: landmass index (or position, for comparison islands),
+  // segmentation detail, segment count and name.  Segments for all
+  // islands are stored together, in island order.
+  struct IslandRecord {
+    uint32_t landmass;
+    int32_t minsegs, absminsegs;
+    uint32_t nsegs;
+    uint32_t name, name_len;    // Offset into STRINGS.
+  };
+
+  // Segment start and end columns and start and end rows.
+  struct SegmentRecord {
+    int32_t isis, ieis, jsis, jeis;
+  };
+
+  // Does a file start with the session file magic number?
+  static bool isSessionFile(std::string path);
+
+  // Write a session file.  Section lengths must be filled in in the
+  // header; the remaining header identification and offset fields
+  // are set here.
+  static void write(std::string path, Header &hdr,
+                    const void *const data[NSECTIONS]);
+
+  // Map and check an existing session file.
+  explicit SessionFile(std::string path);
+
+  const Header &header(void) const { return *hdr; }
+
+  // Access a section, checking that it holds n elements of type T.
+  template<typename T> const T *section(Section s, std::size_t n) const {
+    check(s, n * sizeof(T));
+    return reinterpret_cast<const T *>(file.data() + hdr->offset[s]);
+  }
+
+  // Extract a string from the string section.
+  std::string str(uint32_t off, uint32_t len) const;
+
+private:
+  SessionFile(const SessionFile &);
+  SessionFile &operator=(const SessionFile &);
+
+  void check(Section s, std::size_t len) const;
+
+  MappedFile file;
+  const Header *hdr;
+};
+
+#endif
@@ -0,0 +1,263 @@
+//----------------------------------------------------------------------
+// FILE:   TileCache.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Asynchronous tile rasteriser and tile cache for the map view.
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+#include "TileCache.hh"
+
+
+// Start rendering threads: default to one less than the number of
+// cores, leaving one for the UI.
+
+TileCache::TileCache(unsigned int cap, unsigned int nthreads) :
+  model(0), capacity(cap), stopping(false), generation(0)
+{
+  if (nthreads == 0) {
+    unsigned int ncores = thread::hardware_concurrency();
+    nthreads = ncores > 1 ? ncores - 1 : 1;
+  }
+  for (unsigned int i = 0; i < nthreads; ++i)
+    threads.push_back(thread(&TileCache::worker, this));
+}
+
+TileCache::~TileCache()
+{
+  {
+    lock_guard<mutex> lk(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (unsigned int i = 0; i < threads.size(); ++i) threads[i].join();
+}
+
+
+// Model and view changes.  The caller holds the model lock while
+// changing the model.
+
+void TileCache::setModel(const IslaModel *m)
+{
+  model = m;
+  clear();
+}
+
+void TileCache::setView(ViewPtr v)
+{
+  lock_guard<mutex> lk(lock);
+  vw = v;
+  dropQueued();
+}
+
+
+// Find a tile, queueing it for rendering if it's not cached.  Tiles
+// are rendered most recently requested first, so that the current
+// view is filled in before any tiles that have been panned past.
+
+TileCache::PixelsPtr TileCache::fetch(int tx, int ty)
+{
+  lock_guard<mutex> lk(lock);
+  if (!vw) return PixelsPtr();
+  Key k(vw->scale, tx, ty);
+  TileMap::iterator it = tiles.find(k);
+  if (it != tiles.end()) {
+    lru.splice(lru.begin(), lru, it->second.second);
+    return it->second.first;
+  }
+  if (queued.insert(k).second) {
+    Job job;
+    job.key = k;
+    job.view = vw;
+    job.generation = generation;
+    queue.push_front(job);
+    wake.notify_one();
+  }
+  return PixelsPtr();
+}
+
+
+// Drop cached tiles overlapping a longitude/latitude box.  Tile
+// longitudes aren't reduced modulo 360, so the overlap test is done
+// relative to the tile's western edge.
+
+void TileCache::invalidate(double lon0, double lon1, double lat0, double lat1)
+{
+  lock_guard<mutex> lk(lock);
+  if (!vw) return;
+  double lattop = vw->lattop;
+  TileMap::iterator it = tiles.begin();
+  while (it != tiles.end()) {
+    const Key &k = it->first;
+    double tw = TILE / k.scale;
+    double tlon0 = k.tx * tw;
+    double tlat1 = lattop - k.ty * tw, tlat0 = tlat1 - tw;
+    double d = fmod(lon0 - tlon0, 360.0);
+    if (d < 0) d += 360.0;
+    bool lonhit = d < tw || d + (lon1 - lon0) > 360.0;
+    bool lathit = lat0 < tlat1 && lat1 > tlat0;
+    if (lonhit && lathit) {
+      lru.erase(it->second.second);
+      tiles.erase(it++);
+    } else
+      ++it;
+  }
+}
+
+void TileCache::clear(void)
+{
+  lock_guard<mutex> lk(lock);
+  tiles.clear();
+  lru.clear();
+  dropQueued();
+  ++generation;
+}
+
+void TileCache::dropQueued(void)
+{
+  queue.clear();
+  queued.clear();
+}
+
+
+// Add a tile to the cache, evicting least recently used tiles if
+// the cache is full.  Called with the cache lock held.
+
+void TileCache::insert(const Key &k, PixelsPtr px)
+{
+  TileMap::iterator it = tiles.find(k);
+  if (it != tiles.end()) lru.erase(it->second.second);
+  lru.push_front(k);
+  tiles[k] = make_pair(px, lru.begin());
+  while (tiles.size() > capacity) {
+    tiles.erase(lru.back());
+    lru.pop_back();
+  }
+}
+
+
+// Rendering thread.  The model lock is shared from before rendering
+// until the tile is in the cache, so an edit (made with the model
+// lock held exclusively) either happens before the tile is rendered
+// or after it is cached, in which case invalidating the edited area
+// removes it.  Rendering only reads the model, so workers don't
+// block each other.
+
+void TileCache::worker(void)
+{
+  for (;;) {
+    Job job;
+    {
+      unique_lock<mutex> lk(lock);
+      while (!stopping && queue.empty()) wake.wait(lk);
+      if (stopping) return;
+      job = queue.front();
+      queue.pop_front();
+    }
+    bool ok = false;
+    {
+      shared_lock<shared_mutex> ml(mlock);
+      if (model) {
+        Pixels *px = new Pixels(3 * TILE * TILE);
+        PixelsPtr pxp(px);
+        render(*job.view, *model, job.key.tx * TILE, job.key.ty * TILE,
+               TILE, TILE, &(*px)[0]);
+        lock_guard<mutex> lk(lock);
+        queued.erase(job.key);
+        ok = job.generation == generation;
+        if (ok) insert(job.key, pxp);
+      }
+    }
+    if (ok && notify) notify(job.key);
+  }
+}
+
+
+// Blend colour components: f = 0 gives a, f = 1 gives b.
+
+static unsigned char blend(unsigned char a, unsigned char b, double f)
+{
+  return static_cast<unsigned char>(a + (b - a) * f + 0.5);
+}
+
+
+// Render a block of world pixels.  Each pixel column and row is
+// mapped to the grid column and row containing its centre, then
+// coloured from the summary for the block of cells at the view's
+// mask pyramid level: the land fraction of the block gives the blend
+// between ocean and land colours, using the island colour if most of
+// the land is island.  Pixel rows in the same pyramid row are copied
+// from the row above.  At full resolution, pixels are coloured
+// from the run-length encoded mask rows instead.
+
+void TileCache::render(const View &v, const IslaModel &m,
+                       int x0, int y0, int w, int h, unsigned char *rgb)
+{
+  const MaskPyramid &pyr = m.pyramid();
+  const MaskRuns &runs = m.runs();
+  int nlon = v.iclons.size() - 1, nlat = v.iclats.size() - 1;
+  int level = v.level;
+  if (pyr.levels() <= level || pyr.nlon(0) != nlon || pyr.nlat(0) != nlat ||
+      runs.nlat() != nlat) {
+    // Model and view out of step (model being replaced): the tile
+    // will be discarded anyway.
+    for (int i = 0; i < w * h; ++i, rgb += 3)
+      memcpy(rgb, v.ocean, 3);
+    return;
+  }
+
+  vector<int> cols(w), rows(h);
+  for (int x = 0; x < w; ++x) {
+    double lon = fmod((x0 + x + 0.5) / v.scale, 360.0);
+    if (lon < 0) lon += 360.0;
+    if (lon >= v.iclons[nlon]) cols[x] = 0;
+    else cols[x] = upper_bound(v.iclons.begin(), v.iclons.end(), lon) -
+           v.iclons.begin() - 1;
+  }
+  for (int y = 0; y < h; ++y) {
+    double lat = v.lattop - (y0 + y + 0.5) / v.scale;
+    if (lat < v.iclats[0] || lat >= v.iclats[nlat]) rows[y] = -1;
+    else rows[y] = upper_bound(v.iclats.begin(), v.iclats.end(), lat) -
+           v.iclats.begin() - 1;
+  }
+
+  const unsigned char *colours[3] = { v.ocean, v.land, v.island };
+  int stride = 3 * w;
+  for (int y = 0; y < h; ++y) {
+    unsigned char *p = rgb + y * stride;
+    int r = rows[y];
+    if (y > 0 && (r >> level) == (rows[y-1] >> level)) {
+      memcpy(p, p - stride, stride);
+      continue;
+    }
+    if (level == 0 && r >= 0) {
+      // Cells at least a pixel across: fill each stretch of pixels
+      // falling in a single run of the row in one go.
+      const MaskRuns::Row &row = runs.row(r);
+      int x = 0;
+      while (x < w) {
+        const MaskRuns::Run &run = row[MaskRuns::find(row, cols[x])];
+        int x1 = x + 1;
+        while (x1 < w && cols[x1] >= run.c0 && cols[x1] < run.c1) ++x1;
+        const unsigned char *col = colours[run.cls];
+        for (; x < x1; ++x, p += 3) {
+          p[0] = col[0];  p[1] = col[1];  p[2] = col[2];
+        }
+      }
+      continue;
+    }
+    for (int x = 0; x < w; ++x, p += 3) {
+      int c = cols[x];
+      if (r < 0 || c < 0) { memcpy(p, v.ocean, 3);  continue; }
+      const MaskPyramid::Summary &sum = pyr(level, r >> level, c >> level);
+      const unsigned char *col = 2 * sum.island > sum.land ? v.island : v.land;
+      double f = sum.landFraction();
+      for (int i = 0; i < 3; ++i) p[i] = blend(v.ocean[i], col[i], f);
+    }
+  }
+}
@@ -0,0 +1,135 @@
+//----------------------------------------------------------------------
+// FILE:   TileCache.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Asynchronous tile rasteriser and tile cache for the map view.
+//
+// Map cells are rendered in fixed-size square tiles in "world" pixel
+// coordinates for a given scale: world pixel column X covers
+// longitudes [X, X + 1) / scale (modulo 360) and world pixel row Y
+// covers latitudes lattop - [Y, Y + 1) / scale.  Tiles are keyed by
+// scale and tile indexes, so panning only needs new tiles at the
+// edges of the view and returning to a previous zoom level can reuse
+// tiles that are still cached.
+//
+// Missing tiles are queued for rendering on a pool of background
+// threads; a notification callback is called (on the worker thread)
+// when each tile is ready.  Rendering threads share the model lock
+// while reading the model, so they can render tiles concurrently;
+// code changing the model must hold it exclusively.
+//----------------------------------------------------------------------
+
+#ifndef _H_TILECACHE_
+#define _H_TILECACHE_
+
+#include <vector>
+#include <map>
+#include <list>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <functional>
+#include <boost/shared_ptr.hpp>
+
+#include "IslaModel.hh"
+
+class TileCache {
+public:
+  static const int TILE = 256;  // Tile size (pixels).
+
+  // Everything needed to render cells apart from the model itself.
+  struct View {
+    double scale;               // Pixels per degree.
+    double lattop;              // Latitude at world pixel row 0.
+    std::vector<double> iclons; // Inter-cell longitudes.
+    std::vector<double> iclats; // Inter-cell latitudes.
+    int level;                  // Mask pyramid level to use.
+    unsigned char ocean[3], land[3], island[3];
+  };
+  typedef boost::shared_ptr<const View> ViewPtr;
+
+  struct Key {
+    Key(double s = 0, int x = 0, int y = 0) : scale(s), tx(x), ty(y) { }
+    double scale;
+    int tx, ty;
+    bool operator<(const Key &o) const {
+      if (scale != o.scale) return scale < o.scale;
+      return tx != o.tx ? tx < o.tx : ty < o.ty;
+    }
+  };
+
+  typedef std::vector<unsigned char> Pixels;   // RGB, row major.
+  typedef boost::shared_ptr<const Pixels> PixelsPtr;
+  typedef std::function<void(const Key &)> Notify;
+
+  TileCache(unsigned int capacity, unsigned int nthreads = 0);
+  ~TileCache();
+
+  // Set model, view parameters and tile ready callback.  Changing
+  // the model discards all cached and queued tiles; changing the
+  // view only discards queued tiles, since cached tiles are keyed by
+  // scale and may be reused later.  Call setModel with the model
+  // lock held.
+  void setModel(const IslaModel *m);
+  void setView(ViewPtr v);
+  void setNotify(Notify n) { notify = n; }
+  ViewPtr view(void) const { return vw; }
+
+  // Lock to hold exclusively while changing the model.
+  std::shared_mutex &modelLock(void) { return mlock; }
+
+  // Find a cached tile for the current view.  If it's not there,
+  // queue it for rendering and return a null pointer.
+  PixelsPtr fetch(int tx, int ty);
+
+  // Drop cached tiles at any scale covering part of a longitude and
+  // latitude box (after an edit), or all tiles.
+  void invalidate(double lon0, double lon1, double lat0, double lat1);
+  void clear(void);
+
+  // Render a block of world pixels synchronously.  Must be called
+  // with the model lock held (or on the thread that changes the
+  // model).
+  static void render(const View &v, const IslaModel &m,
+                     int x0, int y0, int w, int h, unsigned char *rgb);
+
+  // Tile index containing a world pixel coordinate.
+  static int tileIndex(int p) {
+    return p >= 0 ? p / TILE : -((-p - 1) / TILE) - 1;
+  }
+
+private:
+  struct Job {
+    Key key;
+    ViewPtr view;
+    unsigned int generation;
+  };
+
+  void worker(void);
+  void insert(const Key &k, PixelsPtr px);
+  void dropQueued(void);
+
+  const IslaModel *model;
+  ViewPtr vw;
+  Notify notify;
+  unsigned int capacity;
+
+  std::shared_mutex mlock;      // Model lock.
+  std::mutex lock;              // Protects everything below.
+  std::condition_variable wake;
+  bool stopping;
+  unsigned int generation;      // Bumped when cached tiles go stale.
+  std::deque<Job> queue;
+  std::set<Key> queued;
+  std::list<Key> lru;           // Most recently used at the front.
+  typedef std::map<Key, std::pair<PixelsPtr,
+                                  std::list<Key>::iterator> > TileMap;
+  TileMap tiles;
+  std::vector<std::thread> threads;
+};
+
+#endif
@@ -0,0 +1,261 @@
+//----------------------------------------------------------------------
+// FILE:   UMFile.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Access to UM format files through a memory map.
+//----------------------------------------------------------------------
+
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
+using namespace std;
+
+#include "UMFile.hh"
+
+
+// Value of a fixed header word for a given word size and byte order.
+
+static long long headerWord(const unsigned char *hdr, int pos,
+                            int wsize, bool swap)
+{
+  const unsigned char *w = hdr + (pos - 1) * wsize;
+  uint64_t v = 0;
+  for (int b = 0; b < wsize; ++b) {
+    int k = swap ? b : wsize - 1 - b;
+    v = (v << 8) | w[k];
+  }
+  if (wsize == 4) return static_cast<int32_t>(static_cast<uint32_t>(v));
+  return static_cast<int64_t>(v);
+}
+
+
+// Determine word size and byte order from the start of a file of a
+// given size.  NetCDF and HDF5 files are rejected by their magic
+// numbers first (the record count of a classic NetCDF file looks
+// just like a 32-bit sub-model code).  Otherwise, an interpretation
+// of the fixed header is accepted only if the format version (word
+// 1) is missing or plausible, the sub-model code (word 2) and data
+// set type (word 5) are small positive integers, and any lookup
+// table lies within the file.
+
+bool UMFile::detect(const unsigned char *hdr, size_t n, size_t filesize,
+                    int &wsize, bool &swap)
+{
+  if (n >= 4 && (memcmp(hdr, "CDF\x01", 4) == 0 ||
+                 memcmp(hdr, "CDF\x02", 4) == 0 ||
+                 memcmp(hdr, "CDF\x05", 4) == 0 ||
+                 memcmp(hdr, "\x89HDF", 4) == 0))
+    return false;
+  for (int i = 0; i < 4; ++i) {
+    wsize = i < 2 ? 8 : 4;  swap = i % 2 == 1;
+    if (n < static_cast<size_t>(wsize * FH_LEN)) continue;
+    long long version = headerWord(hdr, FH_VERSION, wsize, swap);
+    long long submodel = headerWord(hdr, FH_SUBMODEL, wsize, swap);
+    long long type = headerWord(hdr, FH_DATASET_TYPE, wsize, swap);
+    if (version != IMDI && (version < 1 || version > 100)) continue;
+    if (submodel < 1 || submodel > 4) continue;
+    if (type < 1 || type > 10) continue;
+    long long start = headerWord(hdr, FH_LOOKUP_START, wsize, swap);
+    if (start != IMDI) {
+      long long dim1 = headerWord(hdr, FH_LOOKUP_DIM1, wsize, swap);
+      long long dim2 = headerWord(hdr, FH_LOOKUP_DIM2, wsize, swap);
+      long long words = filesize / wsize;
+      if (start <= FH_LEN || start > words || dim1 < 64 || dim2 < 0 ||
+          dim2 > (words - start + 1) / dim1)
+        continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool UMFile::isUMFile(string path)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) return false;
+  unsigned char hdr[8 * FH_LEN];
+  size_t n = fread(hdr, 1, sizeof(hdr), fp);
+  long size = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+  fclose(fp);
+  if (size < 0) return false;
+  int wsize;
+  bool swap;
+  return detect(hdr, n, size, wsize, swap);
+}
+
+
+// Map the file and determine its word size and byte order.
+
+UMFile::UMFile(string path, bool writable) :
+  mf(path, writable), wsize(8), swap(false)
+{
+  if (mf.size() < static_cast<size_t>(4 * FH_LEN))
+    throw runtime_error("Not a UM file (too short): " + path);
+  if (!detect(mf.data(), mf.size(), mf.size(), wsize, swap))
+    throw runtime_error("Not a UM file (bad fixed header): " + path);
+}
+
+
+// Copy a word from the map, in native byte order.
+
+void UMFile::load(size_t pos, unsigned char *buf) const
+{
+  if (pos < 1 || pos > words())
+    throw runtime_error("Read past end of UM file: " + path());
+  const unsigned char *src = mf.data() + (pos - 1) * wsize;
+  if (swap)
+    for (int i = 0; i < wsize; ++i) buf[i] = src[wsize - 1 - i];
+  else
+    memcpy(buf, src, wsize);
+}
+
+long long UMFile::word(size_t pos) const
+{
+  unsigned char buf[8];
+  load(pos, buf);
+  if (wsize == 8) { int64_t v;  memcpy(&v, buf, 8);  return v; }
+  int32_t v;  memcpy(&v, buf, 4);  return v;
+}
+
+double UMFile::real(size_t pos) const
+{
+  unsigned char buf[8];
+  load(pos, buf);
+  if (wsize == 8) { double v;  memcpy(&v, buf, 8);  return v; }
+  float v;  memcpy(&v, buf, 4);  return v;
+}
+
+
+// Write a word to the map from native byte order.
+
+void UMFile::store(size_t pos, const unsigned char *buf)
+{
+  if (!mf.writable())
+    throw runtime_error("UM file not opened for writing: " + path());
+  if (pos < 1 || pos > words())
+    throw runtime_error("Write past end of UM file: " + path());
+  unsigned char *dst = mf.data() + (pos - 1) * wsize;
+  if (swap)
+    for (int i = 0; i < wsize; ++i) dst[i] = buf[wsize - 1 - i];
+  else
+    memcpy(dst, buf, wsize);
+}
+
+void UMFile::setWord(size_t pos, long long val)
+{
+  unsigned char buf[8];
+  if (wsize == 8) { int64_t v = val;  memcpy(buf, &v, 8); }
+  else { int32_t v = val;  memcpy(buf, &v, 4); }
+  store(pos, buf);
+}
+
+void UMFile::setReal(size_t pos, double val)
+{
+  unsigned char buf[8];
+  if (wsize == 8) memcpy(buf, &val, 8);
+  else { float v = val;  memcpy(buf, &v, 4); }
+  store(pos, buf);
+}
+
+
+// Open up n words of space before word pos: the file is extended,
+// everything from pos onwards is moved up, and the fixed header
+// section pointers and lookup table field offsets past pos are
+// adjusted to match.  If the field data starts on a 512-word sector
+// boundary, n is rounded up to keep it there.  Returns the number of
+// words inserted.
+
+size_t UMFile::insert(size_t pos, size_t n)
+{
+  static const int starts[] = { 100, 105, 110, 115, 120, 125, 130,
+                                135, 140, 142, 144, 150, FH_DATA_START };
+  static const int nstarts = sizeof(starts) / sizeof(starts[0]);
+  const size_t SECTOR = 512;
+  long long dstart = fixhd(FH_DATA_START);
+  if (dstart > 0 && (dstart - 1) % SECTOR == 0)
+    n = (n + SECTOR - 1) / SECTOR * SECTOR;
+  if (n == 0) return 0;
+  if (pos < 1 || pos > words() + 1)
+    throw runtime_error("Bad insertion point in UM file: " + path());
+  size_t oldlen = mf.size(), tail = oldlen - (pos - 1) * wsize;
+  mf.resize(oldlen + n * wsize);
+  unsigned char *from = mf.data() + (pos - 1) * wsize;
+  memmove(from + n * wsize, from, tail);
+  memset(from, 0, n * wsize);
+
+  for (int i = 0; i < nstarts; ++i) {
+    long long s = fixhd(starts[i]);
+    if (s >= static_cast<long long>(pos)) setWord(starts[i], s + n);
+  }
+  for (int f = 1; f <= nfields(); ++f) {
+    long long b = lookup(f, LB_LBEGIN);
+    if (b > 0 && b + 1 >= static_cast<long long>(pos))
+      setWord(lookupPos(f, LB_LBEGIN), b + n);
+  }
+  return n;
+}
+
+
+// Header sections.
+
+long long UMFile::intConst(int i) const
+{
+  long long n = fixhd(FH_INTC_LEN);
+  if (i < 1 || i > n)
+    throw runtime_error("Missing integer constant in UM file: " + path());
+  return word(fixhd(FH_INTC_START) + i - 1);
+}
+
+int UMFile::nfields(void) const
+{
+  long long n = fixhd(FH_LOOKUP_DIM2);
+  return n > 0 ? n : 0;
+}
+
+size_t UMFile::lookupPos(int field, int item) const
+{
+  long long dim1 = fixhd(FH_LOOKUP_DIM1);
+  if (field < 1 || field > nfields() || item < 1 || item > dim1)
+    throw runtime_error("Bad lookup table index in UM file: " + path());
+  return fixhd(FH_LOOKUP_START) + (field - 1) * dim1 + item - 1;
+}
+
+long long UMFile::lookup(int field, int item) const
+{
+  return word(lookupPos(field, item));
+}
+
+double UMFile::lookupReal(int field, int item) const
+{
+  return real(lookupPos(field, item));
+}
+
+int UMFile::findField(int stash) const
+{
+  for (int f = 1; f <= nfields(); ++f)
+    if (lookup(f, LB_LBUSER4) == stash) return f;
+  return 0;
+}
+
+
+// Field data normally starts at the word offset given in the lookup
+// table, but older files leave that unset, in which case fields
+// follow one another from the start of the data section.
+
+size_t UMFile::fieldStart(int field) const
+{
+  long long start = lookup(field, LB_LBEGIN);
+  if (start > 0) return start + 1;
+  start = fixhd(FH_DATA_START);
+  for (int f = 1; f < field; ++f) start += lookup(f, LB_LBLREC);
+  return start;
+}
+
+void UMFile::checkRange(long long start, long long n, const char *what) const
+{
+  if (start < 1 || n < 0 ||
+      static_cast<unsigned long long>(start - 1 + n) > words())
+    throw runtime_error(string("Bad ") + what + " in UM file: " + path());
+}
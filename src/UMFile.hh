@@ -0,0 +1,122 @@
+//----------------------------------------------------------------------
+// FILE:   UMFile.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Access to UM format files (dumps, fieldsfiles and ancillary files)
+// through a memory map.
+//
+// The file is mapped as a whole, but nothing is copied or converted
+// up front: header words and data values are byte-swapped one at a
+// time as they are read, so only the pages actually used are ever
+// touched, even for very large dumps.  Both 32-bit and 64-bit files
+// of either endianness are handled; the word size and byte order are
+// worked out from the fixed header, checking the format version,
+// sub-model, data set type and lookup table position together so
+// that other binary formats (NetCDF in particular) are not mistaken
+// for UM files.
+//
+// Files opened for writing are updated in place through the map;
+// sections can be grown by inserting space, which moves only the
+// part of the file after the insertion point.
+//
+// All header and word indexes are 1-based, as in the UM file format
+// documentation (UMDP F3).
+//----------------------------------------------------------------------
+
+#ifndef _H_UMFILE_
+#define _H_UMFILE_
+
+#include <string>
+#include <cstddef>
+
+#include "MappedFile.hh"
+
+class UMFile {
+public:
+  // Missing integer value.
+  enum { IMDI = -32768 };
+
+  // Fixed header entries.
+  enum {
+    FH_LEN = 256,               // Fixed header length (words).
+    FH_VERSION = 1,             // Data set format version.
+    FH_SUBMODEL = 2,            // 1 = atmosphere, 2 = ocean, ...
+    FH_DATASET_TYPE = 5,        // 1 = dump, 3 = fieldsfile, 4 = ancil.
+    FH_INTC_START = 100,        // Integer constants.
+    FH_INTC_LEN = 101,
+    FH_EXTRA_START = 130,       // Extra constants.
+    FH_EXTRA_LEN = 131,
+    FH_LOOKUP_START = 150,      // Lookup table.
+    FH_LOOKUP_DIM1 = 151,
+    FH_LOOKUP_DIM2 = 152,
+    FH_DATA_START = 160         // Field data.
+  };
+
+  // Lookup table entries.
+  enum {
+    LB_LBLREC = 15,             // Field record length (words).
+    LB_LBROW = 18,              // Number of rows.
+    LB_LBNPT = 19,              // Number of points per row.
+    LB_LBPACK = 21,             // Packing code.
+    LB_LBEGIN = 29,             // Field start (0-based word offset).
+    LB_LBUSER1 = 39,            // Data type: 1 = real, 2 = int, 3 = logical.
+    LB_LBUSER4 = 42,            // STASH code.
+    LB_BZY = 59,                // Latitude origin: row 1 at BZY + BDY.
+    LB_BDY = 60,                // Latitude spacing.
+    LB_BZX = 61,                // Longitude origin.
+    LB_BDX = 62                 // Longitude spacing.
+  };
+
+  UMFile(std::string path, bool writable = false);
+
+  // Does a file look like a UM file?
+  static bool isUMFile(std::string path);
+
+  std::string path(void) const { return mf.path(); }
+  int wordSize(void) const { return wsize; }
+  bool swapped(void) const { return swap; }
+  std::size_t words(void) const { return mf.size() / wsize; }
+
+  // Header access.
+  long long fixhd(int i) const { return word(i); }
+  long long intConst(int i) const;
+  int nfields(void) const;
+  long long lookup(int field, int item) const;
+  double lookupReal(int field, int item) const;
+
+  // Find the first field with a given STASH code (0 if none), and the
+  // word position of the start of a field's data.
+  int findField(int stash) const;
+  std::size_t fieldStart(int field) const;
+
+  // Integer or real value of a word in the file.
+  long long word(std::size_t pos) const;
+  double real(std::size_t pos) const;
+
+  // Check that words [start, start + n) lie within the file.
+  void checkRange(long long start, long long n, const char *what) const;
+
+  // Update words, insert space and flush changes to disk (writable
+  // files only).
+  void setWord(std::size_t pos, long long val);
+  void setReal(std::size_t pos, double val);
+  std::size_t insert(std::size_t pos, std::size_t n);
+  void sync(void) { mf.sync(); }
+
+private:
+  UMFile(const UMFile &);
+  UMFile &operator=(const UMFile &);
+
+  void load(std::size_t pos, unsigned char *buf) const;
+  void store(std::size_t pos, const unsigned char *buf);
+  static bool detect(const unsigned char *hdr, std::size_t n,
+                     std::size_t filesize, int &wsize, bool &swap);
+  std::size_t lookupPos(int field, int item) const;
+
+  MappedFile mf;
+  int wsize;                    // Word size (bytes).
+  bool swap;                    // Byte-swap words?
+};
+
+#endif
@@ -24,6 +24,9 @@ enum {
   // Tools menu
   ID_SELECT,
   ID_EDIT_MASK,
+  ID_EDIT_RECT,
+  ID_EDIT_LASSO,
+  ID_EDIT_FILL,
 
   // Dialogues
   ID_PREFS_GRID_CHOICE,
@@ -41,12 +44,17 @@ enum {
   ID_CTX_REFINE_ISLAND,
   ID_CTX_RESET_ISLAND,
 
+  // Canvas timers
+  ID_MOTION_TIMER,
+
 #ifdef ISLA_DEBUG
   // Debug menu
   ID_DEBUG_SIZE_OVERLAY,
   ID_DEBUG_REGION_OVERLAY,
   ID_DEBUG_ISMASK_OVERLAY,
   ID_DEBUG_ISISLAND_OVERLAY,
+  ID_DEBUG_PERF_OVERLAY,
+  ID_DEBUG_FRAME_TRACE,
 #endif
 };
 
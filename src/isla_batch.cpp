@@ -0,0 +1,149 @@
+//----------------------------------------------------------------------
+// FILE:   isla_batch.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Main program for headless Isla batch processing: loads land/sea
+// masks, calculates landmasses, ISMASK and islands and writes the
+// results, with all parameters given on the command line.  Multiple
+// mask files are processed in parallel using BatchPipeline.
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <glob.h>
+using namespace std;
+
+#include "BatchPipeline.hh"
+
+static void usage(void)
+{
+  cerr << "Usage: isla-batch [options] maskfile..." << endl
+       << endl
+       << "Options:" << endl
+       << "  -v var   NetCDF mask variable (default: only non-coordinate"
+       << " variable)" << endl
+       << "  -t thr   Island area threshold in km^2 (default: 8.0E6)" << endl
+       << "  -i file  Write island data to ASCII island file" << endl
+       << "  -b       Write binary instead of ASCII island files" << endl
+       << "  -m file  Write mask with landmass, ISMASK and island fields"
+       << " to NetCDF file" << endl
+       << "  -z       Write compressed NetCDF-4 mask files, including"
+       << " island segments" << endl
+       << "  -s file  Write session file" << endl
+       << "  -a       Regrid each input to all standard grids (HadCM3L,"
+       << " HadCM3, HadGEM2)" << endl
+       << "  -f frac  Land fraction for land cells with -a (default: 0.5)"
+       << endl
+       << "  -l file  Read list of mask files from file" << endl
+       << "  -j n     Number of worker threads (default: one per core)"
+       << endl
+       << "  -q       Quiet: don't print summary" << endl
+       << endl
+       << "Mask file arguments may be quoted glob patterns.  When more than"
+       << endl
+       << "one mask file is given, output file names must contain %s, which"
+       << endl
+       << "is replaced by the mask file name without directory or extension."
+       << endl
+       << "Session files (from -s or Isla) may be given in place of mask"
+       << endl
+       << "files: they are restored as saved, without recalculation."
+       << endl
+       << endl
+       << "With -a, inputs are 0/1 masks or land fraction fields on any"
+       << endl
+       << "grid, and output file names must contain %g, which is replaced"
+       << endl
+       << "by the grid name." << endl
+       << endl
+       << "The exit status is 1 if any mask file could not be processed."
+       << endl;
+  exit(1);
+}
+
+
+// Add mask files from a glob pattern (or a plain file name).
+
+static void addFiles(string pattern, vector<string> &files)
+{
+  glob_t g;
+  if (glob(pattern.c_str(), GLOB_NOCHECK, 0, &g) == 0)
+    for (size_t i = 0; i < g.gl_pathc; ++i) files.push_back(g.gl_pathv[i]);
+  globfree(&g);
+}
+
+
+int main(int argc, char *argv[])
+{
+  BatchPipeline::Options opts;
+  vector<string> files;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "v:t:i:m:s:f:l:j:abzq")) != -1) {
+    switch (opt) {
+    case 'v': opts.maskvar = optarg;     break;
+    case 'i': opts.islpattern = optarg;  break;
+    case 'm': opts.outpattern = optarg;  break;
+    case 's': opts.sesspattern = optarg; break;
+    case 'b': opts.binary = true;        break;
+    case 'z': opts.compressed = true;    break;
+    case 'a': opts.allgrids = true;      break;
+    case 'q': opts.quiet = true;         break;
+    case 't': {
+      char *end;
+      opts.threshold = strtod(optarg, &end);
+      if (*end != '\0' || opts.threshold <= 0.0) {
+        cerr << "Invalid island threshold: " << optarg << endl;
+        return 1;
+      }
+      break;
+    }
+    case 'f': {
+      char *end;
+      opts.landfrac = strtod(optarg, &end);
+      if (*end != '\0' || opts.landfrac < 0.0 || opts.landfrac >= 1.0) {
+        cerr << "Invalid land fraction: " << optarg << endl;
+        return 1;
+      }
+      break;
+    }
+    case 'j': {
+      char *end;
+      long n = strtol(optarg, &end, 10);
+      if (*end != '\0' || n < 1) {
+        cerr << "Invalid worker thread count: " << optarg << endl;
+        return 1;
+      }
+      opts.nworkers = n;
+      break;
+    }
+    case 'l': {
+      ifstream list(optarg);
+      if (!list) {
+        cerr << "Cannot open file list: " << optarg << endl;
+        return 1;
+      }
+      string line;
+      while (getline(list, line))
+        if (line.size() > 0 && line[0] != '#') addFiles(line, files);
+      break;
+    }
+    default: usage();
+    }
+  }
+  for (int i = optind; i < argc; ++i) addFiles(argv[i], files);
+  if (files.size() == 0) usage();
+
+  try {
+    BatchPipeline pipeline(opts);
+    return pipeline.run(files) == 0 ? 0 : 1;
+  } catch (std::exception &e) {
+    cerr << "isla-batch: " << e.what() << endl;
+    return 1;
+  }
+}
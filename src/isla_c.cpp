@@ -0,0 +1,222 @@
+//----------------------------------------------------------------------
+// FILE:   isla_c.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// C interface to the Isla core model.
+//----------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+#include "ncFile.h"
+using namespace netCDF;
+
+#include "isla_c.h"
+#include "IslaModel.hh"
+#include "UMFile.hh"
+
+struct isla_model {
+  isla_model(double thr) : model(IslaModel::HadCM3L, thr) { }
+  IslaModel model;
+  string error;
+};
+
+typedef map<LMass, IslaModel::IslandInfo> IslandMap;
+
+
+// Record an error message for a model.
+
+static int fail(isla_model *m, const char *msg)
+{
+  if (m) m->error = msg;
+  return -1;
+}
+
+
+// Map between internal (ascending latitude and longitude) cell
+// indexes and flat indexes into caller buffers.
+
+static int flatIndex(const Grid &g, int r, int c)
+{
+  int nlat = g.nlat(), nlon = g.nlon();
+  if (g.lats_reversed()) r = nlat - r - 1;
+  if (g.lons_reversed()) c = nlon - c - 1;
+  return r * nlon + c;
+}
+
+
+// Build the model mask directly from the caller's buffer.
+
+template<typename T>
+static int loadMask(isla_model *m, int nlat, int nlon,
+                    const double *lats, const double *lons, const T *mask)
+{
+  if (!m) return -1;
+  if (nlat < 2 || nlon < 2 || !lats || !lons || !mask)
+    return fail(m, "invalid grid description or mask buffer");
+  try {
+    GridPtr g(new Grid(vector<double>(lats, lats + nlat),
+                       vector<double>(lons, lons + nlon)));
+    GridData<bool> newmask(g, false);
+    for (int r = 0; r < nlat; ++r)
+      for (int c = 0; c < nlon; ++c)
+        newmask(r, c) = mask[flatIndex(*g, r, c)] != 0;
+    m->model.loadMask(newmask);
+  } catch (std::exception &e) {
+    return fail(m, e.what());
+  }
+  return 0;
+}
+
+
+extern "C" {
+
+isla_model *isla_create(double threshold)
+{
+  try {
+    return new isla_model(threshold);
+  } catch (...) {
+    return 0;
+  }
+}
+
+void isla_destroy(isla_model *m) { delete m; }
+
+const char *isla_last_error(const isla_model *m)
+{
+  return m ? m->error.c_str() : "null model";
+}
+
+int isla_load_mask_u8(isla_model *m, int nlat, int nlon,
+                      const double *lats, const double *lons,
+                      const unsigned char *mask)
+{
+  return loadMask(m, nlat, nlon, lats, lons, mask);
+}
+
+int isla_load_mask_i32(isla_model *m, int nlat, int nlon,
+                       const double *lats, const double *lons,
+                       const int *mask)
+{
+  return loadMask(m, nlat, nlon, lats, lons, mask);
+}
+
+int isla_load_file(isla_model *m, const char *file, const char *var)
+{
+  if (!m) return -1;
+  if (!file) return fail(m, "no file name given");
+  try {
+    string maskvar;
+    if (UMFile::isUMFile(file)) {
+      m->model.loadUMMask(file);
+      return 0;
+    }
+    if (var)
+      maskvar = var;
+    else {
+      NcFile nc(file, NcFile::read);
+      maskvar = IslaModel::findMaskVar(nc);
+    }
+    m->model.loadMask(file, maskvar);
+  } catch (std::exception &e) {
+    return fail(m, e.what());
+  }
+  return 0;
+}
+
+int isla_set_threshold(isla_model *m, double threshold)
+{
+  if (!m) return -1;
+  if (threshold <= 0.0) return fail(m, "invalid island threshold");
+  try {
+    m->model.setIslandThreshold(threshold);
+    m->model.reclassify();
+  } catch (std::exception &e) {
+    return fail(m, e.what());
+  }
+  return 0;
+}
+
+int isla_nlat(const isla_model *m) { return m ? m->model.grid()->nlat() : -1; }
+int isla_nlon(const isla_model *m) { return m ? m->model.grid()->nlon() : -1; }
+
+int isla_landmass_count(const isla_model *m)
+{
+  return m ? m->model.landMassCount() : -1;
+}
+
+int isla_island_count(const isla_model *m)
+{
+  return m ? m->model.islands().size() : -1;
+}
+
+int isla_segment_count(const isla_model *m)
+{
+  if (!m) return -1;
+  const IslandMap &isles = m->model.islands();
+  int n = 0;
+  for (IslandMap::const_iterator it = isles.begin(); it != isles.end(); ++it)
+    n += it->second.segments.size();
+  return n;
+}
+
+int isla_get_landmass(isla_model *m, int *out)
+{
+  if (!m) return -1;
+  if (!out) return fail(m, "null output buffer");
+  const Grid &g = *m->model.grid();
+  for (unsigned int r = 0; r < g.nlat(); ++r)
+    for (unsigned int c = 0; c < g.nlon(); ++c)
+      out[flatIndex(g, r, c)] = m->model.landMass(r, c);
+  return 0;
+}
+
+int isla_get_ismask(isla_model *m, int *out)
+{
+  if (!m) return -1;
+  if (!out) return fail(m, "null output buffer");
+  const Grid &g = *m->model.grid();
+  for (unsigned int r = 0; r < g.nlat(); ++r)
+    for (unsigned int c = 0; c < g.nlon(); ++c)
+      out[flatIndex(g, r, c)] = m->model.isMask(r, c);
+  return 0;
+}
+
+int isla_get_is_island(isla_model *m, unsigned char *out)
+{
+  if (!m) return -1;
+  if (!out) return fail(m, "null output buffer");
+  const Grid &g = *m->model.grid();
+  for (unsigned int r = 0; r < g.nlat(); ++r)
+    for (unsigned int c = 0; c < g.nlon(); ++c)
+      out[flatIndex(g, r, c)] = m->model.isIsland(r, c) ? 1 : 0;
+  return 0;
+}
+
+int isla_get_islands(isla_model *m, int *nsegs,
+                     int *isis, int *ieis, int *jsis, int *jeis)
+{
+  if (!m) return -1;
+  const IslandMap &isles = m->model.islands();
+  if ((!nsegs && !isles.empty()) ||
+      ((!isis || !ieis || !jsis || !jeis) && isla_segment_count(m) > 0))
+    return fail(m, "null output buffer");
+  int iisl = 0, iseg = 0;
+  for (IslandMap::const_iterator it = isles.begin();
+       it != isles.end(); ++it, ++iisl) {
+    const vector<Rect> &segs = it->second.segments;
+    nsegs[iisl] = segs.size();
+    for (unsigned int i = 0; i < segs.size(); ++i, ++iseg) {
+      isis[iseg] = segs[i].x;
+      ieis[iseg] = segs[i].x + segs[i].width - 1;
+      jsis[iseg] = segs[i].y;
+      jeis[iseg] = segs[i].y + segs[i].height - 1;
+    }
+  }
+  return 0;
+}
+
+}
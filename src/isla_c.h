@@ -0,0 +1,79 @@
+/*----------------------------------------------------------------------
+ * FILE:   isla_c.h
+ * DATE:   19-OCT-2026
+ * AUTHOR: Ian Ross
+ *
+ * C interface to the Isla core model, for embedding in Python,
+ * Fortran and other code that already holds land/sea masks in
+ * memory.
+ *
+ * Masks are passed as caller-owned buffers of nlat x nlon values
+ * with longitude varying fastest (C order, which is the same memory
+ * layout as a Fortran array dimensioned (nlon, nlat)).  Non-zero
+ * values are land.  Latitudes and longitudes may be in ascending or
+ * descending order: gridded results are always returned in the same
+ * orientation as the input mask.  The mask buffer is only read
+ * during the load call and need not outlive it.
+ *
+ * Functions returning int return 0 on success and -1 on failure, in
+ * which case isla_last_error gives a description of the problem.
+ *----------------------------------------------------------------------*/
+
+#ifndef _H_ISLA_C_
+#define _H_ISLA_C_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct isla_model isla_model;
+
+/* Create and destroy models.  The island area threshold is in km^2. */
+isla_model *isla_create(double threshold);
+void isla_destroy(isla_model *m);
+
+/* Description of the last error for a model. */
+const char *isla_last_error(const isla_model *m);
+
+/* Load a mask from memory and calculate landmasses, ISMASK and
+ * islands.  The 8-bit and 32-bit variants differ only in the mask
+ * element type. */
+int isla_load_mask_u8(isla_model *m, int nlat, int nlon,
+                      const double *lats, const double *lons,
+                      const unsigned char *mask);
+int isla_load_mask_i32(isla_model *m, int nlat, int nlon,
+                       const double *lats, const double *lons,
+                       const int *mask);
+
+/* Load a mask from a NetCDF file (var may be NULL to guess). */
+int isla_load_file(isla_model *m, const char *file, const char *var);
+
+/* Change island threshold, reclassifying islands without
+ * recalculating landmasses. */
+int isla_set_threshold(isla_model *m, double threshold);
+
+/* Grid size and result counts. */
+int isla_nlat(const isla_model *m);
+int isla_nlon(const isla_model *m);
+int isla_landmass_count(const isla_model *m);
+int isla_island_count(const isla_model *m);
+int isla_segment_count(const isla_model *m);
+
+/* Gridded results: buffers must hold nlat x nlon values. */
+int isla_get_landmass(isla_model *m, int *out);
+int isla_get_ismask(isla_model *m, int *out);
+int isla_get_is_island(isla_model *m, unsigned char *out);
+
+/* Island segments, in the same (UM) index convention as island
+ * files.  nsegs must hold isla_island_count values; isis, ieis, jsis
+ * and jeis must hold isla_segment_count values, and may be NULL if
+ * the corresponding count is zero.  Segments for each island are
+ * stored consecutively. */
+int isla_get_islands(isla_model *m, int *nsegs,
+                     int *isis, int *ieis, int *jsis, int *jeis);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+//----------------------------------------------------------------------
+// FILE:   isla_server.cpp
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Main program for the Isla service: keeps masks and island
+// calculations resident and answers requests on a Unix domain
+// socket.  See IslaServer.hh for the request protocol.
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <csignal>
+#include <unistd.h>
+using namespace std;
+
+#include "IslaServer.hh"
+
+static void usage(void)
+{
+  cerr << "Usage: isla-server [-t thr] socket" << endl
+       << endl
+       << "Options:" << endl
+       << "  -t thr   Default island area threshold in km^2 (default: 8.0E6)"
+       << endl;
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  double threshold = 8.0E6;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:")) != -1) {
+    switch (opt) {
+    case 't': {
+      char *end;
+      threshold = strtod(optarg, &end);
+      if (*end != '\0' || threshold <= 0.0) {
+        cerr << "Invalid island threshold: " << optarg << endl;
+        return 1;
+      }
+      break;
+    }
+    default: usage();
+    }
+  }
+  if (optind != argc - 1) usage();
+
+  // Clients going away mid-response shouldn't kill the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  try {
+    IslaServer server(argv[optind], threshold);
+    server.run();
+  } catch (std::exception &e) {
+    cerr << "isla-server: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
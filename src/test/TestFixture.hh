@@ -0,0 +1,74 @@
+//----------------------------------------------------------------------
+// FILE:   TestFixture.hh
+// DATE:   19-OCT-2026
+// AUTHOR: Ian Ross
+//
+// Shared setup for the test programs, which work on the standard
+// HadCM3L test mask in std_mask.nc.
+//----------------------------------------------------------------------
+
+#ifndef _H_TESTFIXTURE_
+#define _H_TESTFIXTURE_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <cassert>
+
+#include "IslaModel.hh"
+
+// Read the standard test mask, without calculating anything from it.
+
+inline GridData<bool> readTestMask(void)
+{
+  netCDF::NcFile nc("std_mask.nc", netCDF::NcFile::read);
+  GridPtr gr(new Grid(nc));
+  return GridData<bool>(gr, nc, "mask");
+}
+
+// Load the standard test mask into a model, calculating landmasses
+// and islands, and check that there are some of each.
+
+inline void loadTestMask(IslaModel &model)
+{
+  model.loadMask("std_mask.nc", "mask");
+  GridPtr gr = model.grid();
+  std::cout << "nlat=" << gr->nlat() << " nlon=" << gr->nlon()
+            << " landmasses=" << model.landMassCount()
+            << " islands=" << model.islands().size() << std::endl;
+  assert(model.landMassCount() > 0);
+  assert(model.islands().size() > 0);
+}
+
+// Overwrite the second coordinate of the first island segment saved
+// in a mask file with the first, leaving the mask hash alone, so
+// that loading the file gives a different segmentation from a
+// fresh calculation.
+
+inline void corruptSegments(const char *ncfile)
+{
+  netCDF::NcFile nc(ncfile, netCDF::NcFile::write);
+  netCDF::NcVar segvar = nc.getVar("segment_bounds");
+  std::vector<size_t> start(2, 0), count(2, 1);
+  int x0;
+  segvar.getVar(start, count, &x0);
+  start[1] = 1;
+  segvar.putVar(start, count, &x0);
+}
+
+// Do two models have the same islands and island segmentations?
+
+inline bool sameIslands(const IslaModel &a, const IslaModel &b)
+{
+  typedef std::map<LMass, IslaModel::IslandInfo> IslandMap;
+  const IslandMap &ai = a.islands(), &bi = b.islands();
+  if (ai.size() != bi.size()) return false;
+  for (IslandMap::const_iterator it = ai.begin(), bit = bi.begin();
+       it != ai.end(); ++it, ++bit)
+    if (it->first != bit->first ||
+        it->second.segments != bit->second.segments)
+      return false;
+  return true;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cassert>
+#include "BatchPipeline.hh"
+#include "TestFixture.hh"
+
+using namespace std;
+
+int main(void)
+{
+  try {
+    // Output file names from patterns.
+    assert(BatchPipeline::outputName("out/%s-%g.isl", "in/mask.nc",
+                                     "HadCM3") == "out/mask-HadCM3.isl");
+    assert(BatchPipeline::outputName("%s.isl", "mask") == "mask.isl");
+
+    // All-grids batch runs: one island file per input and grid, and
+    // an input whose output can't be written counts as one failure,
+    // not one per grid, with errors naming the grid.
+    {
+      BatchPipeline::Options opts;
+      opts.allgrids = true;
+      opts.quiet = true;
+      opts.nworkers = 2;
+      opts.islpattern = "test_BatchPipeline-%s-%g.isl";
+      vector<string> files(1, "std_mask.nc");
+      assert(BatchPipeline(opts).run(files) == 0);
+      for (int g = IslaModel::HadCM3L; g <= IslaModel::HadGEM2; ++g) {
+        string isl = BatchPipeline::outputName
+          (opts.islpattern, "std_mask.nc",
+           IslaModel::gridName(static_cast<IslaModel::GridType>(g)));
+        FILE *fp = fopen(isl.c_str(), "r");
+        assert(fp);
+        fclose(fp);
+        remove(isl.c_str());
+      }
+      opts.islpattern = "no-such-directory/%s-%g.isl";
+      files.push_back("std_mask.nc");
+      ostringstream errs;
+      streambuf *cerrbuf = cerr.rdbuf(errs.rdbuf());
+      int nfail = BatchPipeline(opts).run(files);
+      cerr.rdbuf(cerrbuf);
+      assert(nfail == 2);
+      assert(errs.str().find("std_mask.nc (HadGEM2): ") != string::npos);
+    }
+
+    // A mask saved with derived data is loaded without recalculation:
+    // a corrupted segmentation comes through to the output.
+    {
+      const char *ncfile = "test_BatchPipeline.nc";
+      IslaModel model(IslaModel::HadCM3L, 8.0E6);
+      loadTestMask(model);
+      model.saveMask(ncfile, true, false);
+      corruptSegments(ncfile);
+      IslaModel bad(IslaModel::HadCM3L, 8.0E6);
+      bad.loadMask(ncfile, "mask");
+      assert(!sameIslands(bad, model));
+
+      BatchPipeline::Options opts;
+      opts.quiet = true;
+      opts.nworkers = 1;
+      opts.sesspattern = "test_BatchPipeline-%s.isls";
+      vector<string> files(1, ncfile);
+      assert(BatchPipeline(opts).run(files) == 0);
+      remove(ncfile);
+      string sess = BatchPipeline::outputName(opts.sesspattern, ncfile);
+      IslaModel out(IslaModel::HadGEM2, 1.0);
+      vector<IslaModel::IslandInfo> comp;
+      out.loadSession(sess, comp);
+      remove(sess.c_str());
+      assert(sameIslands(out, bad));
+    }
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
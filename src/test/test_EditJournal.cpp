@@ -0,0 +1,198 @@
+#include <iostream>
+#include <cstdio>
+#include <cassert>
+#include "IslaModel.hh"
+#include "TestFixture.hh"
+
+using namespace std;
+
+// Does every cell whose mask or island state differs from a saved
+// state lie in one of the model's changed boxes?
+
+static bool changesCovered(IslaModel &model, const GridData<int> &cls)
+{
+  GridPtr gr = model.grid();
+  int nlon = gr->nlon();
+  const vector<Rect> &boxes = model.changedBoxes();
+  for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+    for (int c = 0; c < nlon; ++c) {
+      int now = model.maskVal(r, c) ? 1 + model.isIsland(r, c) : 0;
+      if (now == cls(r, c)) continue;
+      bool in = false;
+      for (unsigned int i = 0; !in && i < boxes.size(); ++i)
+        in = r >= boxes[i].y && r < boxes[i].y + boxes[i].height &&
+          ((c - boxes[i].x) % nlon + nlon) % nlon < boxes[i].width;
+      if (!in) return false;
+    }
+  return true;
+}
+
+static void cellClasses(IslaModel &model, GridData<int> &cls)
+{
+  GridPtr gr = model.grid();
+  for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+    for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+      cls(r, c) = model.maskVal(r, c) ? 1 + model.isIsland(r, c) : 0;
+}
+
+int main(void)
+{
+  try {
+    IslaModel model(IslaModel::HadCM3L, 8.0E6);
+    loadTestMask(model);
+    GridPtr gr = model.grid();
+    int nisl = model.islands().size();
+    map<LMass, IslaModel::IslandInfo> isles = model.islands();
+
+    // Bulk edits: deleting an island landmass and putting it back
+    // restores the original islands.
+    int ir = 0, ic = 0;
+    while (!model.isIsland(ir, ic))
+      if (++ic == static_cast<int>(gr->nlon())) { ic = 0;  ++ir; }
+    GridData<bool> sel(gr, false);
+    model.selectConnected(ir, ic, sel);
+    int nsel = model.setMaskRegion(sel, false);
+    assert(nsel > 0 && model.hasGridChanges());
+    assert(static_cast<int>(model.islands().size()) == nisl - 1);
+    for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+           model.islands().begin(); it != model.islands().end(); ++it) {
+      char name[32];
+      snprintf(name, sizeof(name), "Landmass %u", it->first);
+      assert(it->second.name == name);
+    }
+    assert(model.setMaskRegion(sel, true) == nsel);
+    assert(!model.hasGridChanges());
+    assert(static_cast<int>(model.islands().size()) == nisl);
+    for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+           model.islands().begin(); it != model.islands().end(); ++it)
+      assert(isles[it->first].segments == it->second.segments);
+
+    // Undo and redo of the two region edits, then of a grouped pair
+    // of single-cell edits that cancel out.
+    assert(model.undo());
+    assert(model.hasGridChanges());
+    assert(static_cast<int>(model.islands().size()) == nisl - 1);
+    assert(model.undo() && !model.canUndo());
+    assert(!model.hasGridChanges() && model.maskVal(ir, ic));
+    assert(static_cast<int>(model.islands().size()) == nisl);
+    assert(model.redo() && model.redo() && !model.canRedo());
+    assert(!model.hasGridChanges());
+    model.beginEdit();
+    model.setMask(ir, ic, false);
+    model.setMask(ir, ic, true);
+    model.endEdit();
+    assert(!model.canRedo() && model.undo());
+    assert(static_cast<int>(model.islands().size()) == nisl - 1);
+    assert(model.redo() && !model.hasGridChanges());
+    for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+           model.islands().begin(); it != model.islands().end(); ++it)
+      assert(isles[it->first].segments == it->second.segments);
+
+    // A single-cell edit stroke (deleting an island and adding a
+    // new one-cell island) gives the same landmasses, ISMASK and
+    // islands as a fresh calculation, and undoing it restores the
+    // original ones.  Cells changed by the stroke and its undo lie
+    // in the changed boxes, which don't cover the whole grid.
+    {
+      GridData<int> ism0(gr, 0), cls0(gr, 0);
+      cellClasses(model, cls0);
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+          ism0(r, c) = model.isMask(r, c);
+      int nr = 0, nc = 0;
+      for (bool found = false; !found; ) {
+        if (++nc == static_cast<int>(gr->nlon())) { nc = 0;  ++nr; }
+        found = nr > 0 && nr + 1 < static_cast<int>(gr->nlat());
+        for (int dr = -1; found && dr <= 1; ++dr)
+          for (int dc = -1; found && dc <= 1; ++dc)
+            found = !model.maskVal(nr + dr, (nc + dc + gr->nlon()) %
+                                   gr->nlon());
+      }
+      model.beginEdit();
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+          if (sel(r, c)) model.setMask(r, c, false);
+      model.setMask(nr, nc, true);
+      model.endEdit();
+      assert(!model.changedBoxes().empty() && changesCovered(model, cls0));
+      GridData<int> cls1(gr, 0);
+      cellClasses(model, cls1);
+
+      GridData<bool> edmask(gr, false);
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+          edmask(r, c) = model.maskVal(r, c);
+      IslaModel fresh(IslaModel::HadCM3L, 8.0E6);
+      fresh.loadMask(edmask);
+      assert(model.landMassCount() == fresh.landMassCount());
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c) {
+          assert(model.landMass(r, c) == fresh.landMass(r, c));
+          assert(model.isMask(r, c) == fresh.isMask(r, c));
+          assert(model.isIsland(r, c) == fresh.isIsland(r, c));
+        }
+      assert(model.islands().size() == fresh.islands().size());
+      for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+             fresh.islands().begin(); it != fresh.islands().end(); ++it) {
+        const IslaModel::IslandInfo &is =
+          model.islands().find(it->first)->second;
+        assert(is.segments == it->second.segments);
+        assert(is.name == it->second.name);
+      }
+
+      assert(model.undo() && !model.hasGridChanges());
+      assert(changesCovered(model, cls1));
+      for (unsigned int i = 0; i < model.changedBoxes().size(); ++i)
+        assert(model.changedBoxes()[i].width < static_cast<int>(gr->nlon()) ||
+               model.changedBoxes()[i].height < static_cast<int>(gr->nlat()));
+      assert(static_cast<int>(model.islands().size()) == nisl);
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+          assert(model.isMask(r, c) == ism0(r, c));
+      for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+             model.islands().begin(); it != model.islands().end(); ++it)
+        assert(isles[it->first].segments == it->second.segments &&
+               isles[it->first].name == it->second.name);
+      assert(model.redo() && model.hasGridChanges());
+      assert(model.islands().size() == fresh.islands().size());
+      assert(model.undo());
+    }
+
+    // An island switched off by hand stays off, and a refined island
+    // keeps its detail level, across an edit stroke touching the
+    // refined island.
+    {
+      model.setIsIsland(ir, ic, false);
+      assert(!model.isIsland(ir, ic));
+      int br = 0, bc = 0;
+      LMass blm = 0;
+      for (int r = 0; !blm && r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; !blm && c < static_cast<int>(gr->nlon()); ++c) {
+          if (!model.isIsland(r, c)) continue;
+          model.refineIsland(r, c);
+          const IslaModel::IslandInfo &is =
+            model.islands().find(model.landMass(r, c))->second;
+          if (is.minsegs > is.absminsegs) {
+            br = r;  bc = c;  blm = model.landMass(r, c);
+          }
+        }
+      assert(blm != 0);
+      IslaModel::IslandInfo bis = model.islands().find(blm)->second;
+      model.beginEdit();
+      model.setMask(br, bc, false);
+      model.setMask(br, bc, true);
+      model.endEdit();
+      assert(!model.isIsland(ir, ic));
+      assert(static_cast<int>(model.islands().size()) == nisl - 1);
+      const IslaModel::IslandInfo &is =
+        model.islands().find(model.landMass(br, bc))->second;
+      assert(is.minsegs == bis.minsegs && is.absminsegs == bis.absminsegs);
+      assert(is.segments == bis.segments);
+    }
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,190 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include "IslaModel.hh"
+#include "TestFixture.hh"
+#include "OutlineIndex.hh"
+#include "UMFile.hh"
+
+using namespace std;
+
+// Do two models have the same landmasses, ISMASK, islands and
+// island segmentations?
+
+static bool sameDerived(IslaModel &a, IslaModel &b)
+{
+  GridPtr gr = a.grid();
+  if (a.landMassCount() != b.landMassCount()) return false;
+  for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+    for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+      if (a.landMass(r, c) != b.landMass(r, c) ||
+          a.isMask(r, c) != b.isMask(r, c) ||
+          a.isIsland(r, c) != b.isIsland(r, c))
+        return false;
+  return sameIslands(a, b);
+}
+
+int main(void)
+{
+  try {
+    IslaModel model(IslaModel::HadCM3L, 8.0E6);
+    loadTestMask(model);
+    GridPtr gr = model.grid();
+    int nisl = model.islands().size();
+    map<LMass, IslaModel::IslandInfo> isles = model.islands();
+    int i;
+
+    // Masks saved with derived data, plain and compressed, load back
+    // with the same landmasses, ISMASK and islands as a fresh
+    // calculation.  The derived data is really used: a corrupted
+    // segmentation survives loading while the mask hash matches, but
+    // not once the hash is wrong.  A different island threshold or a
+    // changed mask cell also gives a fresh calculation.
+    {
+      const char *ncfile = "test_IslaModel.nc";
+      for (int compressed = 0; compressed < 2; ++compressed) {
+        model.saveMask(ncfile, true, compressed);
+        assert(!UMFile::isUMFile(ncfile));
+        IslaModel ld(IslaModel::HadCM3L, 8.0E6);
+        ld.loadMask(ncfile, "mask");
+        assert(sameDerived(ld, model));
+        for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+               isles.begin(); it != isles.end(); ++it) {
+          const IslaModel::IslandInfo &is = ld.islands().at(it->first);
+          assert(is.minsegs == it->second.minsegs &&
+                 is.absminsegs == it->second.absminsegs);
+        }
+      }
+      corruptSegments(ncfile);
+      IslaModel bad(IslaModel::HadCM3L, 8.0E6);
+      bad.loadMask(ncfile, "mask");
+      assert(!sameDerived(bad, model));
+      {
+        netCDF::NcFile nc(ncfile, netCDF::NcFile::write);
+        nc.putAtt("isla_mask_hash", "0123456789abcdef");
+      }
+      bad.loadMask(ncfile, "mask");
+      assert(sameDerived(bad, model));
+
+      IslaModel thr(IslaModel::HadCM3L, 1.0E5), thrfresh(thr);
+      thr.loadMask(ncfile, "mask");
+      thrfresh.loadMask("std_mask.nc", "mask");
+      assert(sameDerived(thr, thrfresh));
+
+      int ir = 0, ic = 0;
+      while (!model.isIsland(ir, ic))
+        if (++ic == static_cast<int>(gr->nlon())) { ic = 0;  ++ir; }
+      model.saveMask(ncfile, true, true);
+      GridData<bool> edmask(gr, false);
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+          edmask(r, c) = model.maskVal(r, c);
+      edmask(ir, ic) = false;
+      {
+        netCDF::NcFile nc(ncfile, netCDF::NcFile::write);
+        vector<size_t> start(2), count(2, 1);
+        start[0] = ir;  start[1] = ic;
+        int zero = 0;
+        nc.getVar("mask").putVar(start, count, &zero);
+      }
+      IslaModel edited(IslaModel::HadCM3L, 8.0E6), edfresh(edited);
+      edited.loadMask(ncfile, "mask");
+      edfresh.loadMask(edmask);
+      remove(ncfile);
+      assert(!edited.maskVal(ir, ic) && sameDerived(edited, edfresh));
+    }
+
+    // Threshold sweep: island sets are nested and the result for the
+    // model threshold matches the model's own islands.
+    vector<double> thrs;
+    thrs.push_back(8.0E6);
+    thrs.push_back(1.0E5);
+    IslaModel::ThresholdSweep sweep;
+    model.thresholdSweep(thrs, sweep);
+    assert(sweep.islands.size() == 2);
+    assert(static_cast<int>(sweep.islands[0].size()) == nisl);
+    assert(sweep.islands[1].size() <= sweep.islands[0].size());
+    assert(sweep.segmentations.size() == sweep.islands[0].size());
+    for (i = 0; i < nisl; ++i) {
+      LMass lm = sweep.islands[0][i];
+      assert(isles[lm].segments == sweep.segmentations[lm].segments);
+    }
+
+    // Mask pyramid and row runs: box queries and runs agree with
+    // direct counts, before and after an edit.
+    for (int pass = 0; pass < 2; ++pass) {
+      const MaskPyramid &pyr = model.pyramid();
+      int top = pyr.levels() - 1;
+      assert(pyr.nlat(top) == 1 && pyr.nlon(top) == 1);
+      for (int b = 0; b < 50; ++b) {
+        Rect box(rand() % gr->nlon(), rand() % gr->nlat(), 0, 0);
+        box.width = 1 + rand() % (gr->nlon() - box.x);
+        box.height = 1 + rand() % (gr->nlat() - box.y);
+        unsigned int nland = 0, nisland = 0;
+        for (int r = box.y; r <= box.GetBottom(); ++r)
+          for (int c = box.x; c <= box.GetRight(); ++c) {
+            if (model.maskVal(r, c)) ++nland;
+            if (model.maskVal(r, c) && model.isIsland(r, c)) ++nisland;
+          }
+        MaskPyramid::Summary sum = pyr.summarise(box);
+        assert(sum.n == static_cast<unsigned int>(box.width * box.height));
+        assert(sum.land == nland && sum.island == nisland);
+        assert(pyr.anyLand(box) == (nland > 0));
+        assert(pyr.anyIsland(box) == (nisland > 0));
+      }
+
+      // Row runs cover each row exactly and match cell classes.
+      const MaskRuns &runs = model.runs();
+      for (int r = 0; r < gr->nlat(); ++r) {
+        const MaskRuns::Row &row = runs.row(r);
+        assert(row.front().c0 == 0 && row.back().c1 == gr->nlon());
+        for (unsigned int k = 0; k < row.size(); ++k) {
+          if (k > 0) assert(row[k].c0 == row[k-1].c1);
+          for (int c = row[k].c0; c < row[k].c1; ++c) {
+            MaskPyramid::Class cls = !model.maskVal(r, c) ?
+              MaskPyramid::OCEAN : (model.isIsland(r, c) ?
+                                    MaskPyramid::ISLAND : MaskPyramid::LAND);
+            assert(row[k].cls == cls);
+            assert(MaskRuns::find(row, c) == static_cast<int>(k));
+          }
+        }
+      }
+      for (int c = 0; c < gr->nlon(); ++c)
+        model.setMask(gr->nlat() / 2, c, !model.maskVal(gr->nlat() / 2, c));
+    }
+
+    // Outline index: box queries find exactly the elements whose
+    // extents overlap the box, including boxes wrapping in longitude.
+    OutlineIndex idx;
+    idx.build(gr->nlon(), gr->nlat(), model.islands());
+    assert(idx.size() > 0);
+    for (int b = 0; b < 50; ++b) {
+      int c0 = rand() % gr->nlon(), c1 = rand() % gr->nlon();
+      int r0 = rand() % gr->nlat();
+      int r1 = r0 + rand() % (gr->nlat() - r0);
+      vector<const OutlineIndex::Item *> res;
+      idx.query(c0, c1, r0, r1, res);
+      unsigned int n = 0;
+      for (i = 0; i < idx.size(); ++i) {
+        int ec0, ec1, er0, er1;
+        idx.extent(idx.item(i), ec0, ec1, er0, er1);
+        if (er1 < r0 || er0 > r1) continue;
+        bool hit = false;
+        for (int c = c0; !hit; c = (c + 1) % gr->nlon()) {
+          hit = ec0 <= ec1 ? (c >= ec0 && c <= ec1) : (c >= ec0 || c <= ec1);
+          if (c == c1) break;
+        }
+        if (!hit) continue;
+        assert(n < res.size() && res[n] == &idx.item(i));
+        ++n;
+      }
+      assert(n == res.size());
+    }
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
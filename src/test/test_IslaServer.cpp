@@ -0,0 +1,186 @@
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <csignal>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "IslaModel.hh"
+#include "IslaServer.hh"
+#include "TestFixture.hh"
+
+using namespace std;
+
+static const char *sockfile = "test_IslaServer.sock";
+
+// Connect a client socket to the server.
+
+static int connectTo(const char *path)
+{
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  assert(fd >= 0);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Send a request and read the response: one line, or up to a
+// terminating "." line for multi-line responses.
+
+static string transact(int fd, const string &req, bool multi)
+{
+  string line = req + "\n";
+  assert(write(fd, line.data(), line.size()) ==
+         static_cast<ssize_t>(line.size()));
+  string resp;
+  char buf[4096];
+  for (;;) {
+    if (resp.size() > 0 && resp[resp.size() - 1] == '\n') {
+      if (!multi || resp.compare(0, 3, "ERR") == 0) break;
+      if (resp == ".\n" || (resp.size() >= 3 &&
+                            resp.compare(resp.size() - 3, 3, "\n.\n") == 0))
+        break;
+    }
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) break;
+    resp.append(buf, n);
+  }
+  return resp;
+}
+
+// Does creating a server on the socket path fail with a given
+// message?
+
+static bool refused(const string &what)
+{
+  try {
+    IslaServer again(sockfile, 8.0E6);
+  } catch (exception &e) {
+    return string(e.what()).find(what) != string::npos;
+  }
+  return false;
+}
+
+int main(void)
+{
+  try {
+    signal(SIGPIPE, SIG_IGN);
+    IslaModel model(IslaModel::HadCM3L, 8.0E6);
+    loadTestMask(model);
+    GridPtr gr = model.grid();
+
+    // A regular file at the socket path is left alone.
+    remove(sockfile);
+    FILE *fp = fopen(sockfile, "w");
+    assert(fp);
+    fclose(fp);
+    assert(refused("not a socket"));
+    assert(access(sockfile, F_OK) == 0);
+    remove(sockfile);
+
+    // A socket left behind by a server that has gone away is
+    // replaced.
+    {
+      sockaddr_un addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, sockfile);
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      assert(fd >= 0);
+      assert(bind(fd, reinterpret_cast<sockaddr *>(&addr),
+                  sizeof(addr)) == 0);
+      close(fd);
+    }
+
+    {
+      IslaServer server(sockfile, 8.0E6);
+      thread runner(&IslaServer::run, &server);
+
+      // A second server on a live socket is refused.
+      assert(refused("already in use"));
+
+      int fd = connectTo(sockfile);
+      assert(fd >= 0);
+      ostringstream exp;
+      exp << "OK " << gr->nlon() << " " << gr->nlat() << " "
+          << model.landMassCount() << " " << model.islands().size() << "\n";
+      assert(transact(fd, "load std_mask.nc mask", false) == exp.str());
+
+      ostringstream body;
+      model.saveIslands(body);
+      exp.str("");
+      exp << "OK " << model.islands().size() << "\n" << body.str() << ".\n";
+      assert(transact(fd, "islands std_mask.nc", true) == exp.str());
+
+      const IslaModel::IslandInfo &is = model.islands().begin()->second;
+      ostringstream segs;
+      IslaModel::writeSegments(segs, is.segments);
+      exp.str("");
+      exp << "OK " << is.name << "\n" << segs.str() << ".\n";
+      ostringstream req;
+      req << "landmass std_mask.nc " << model.islands().begin()->first;
+      assert(transact(fd, req.str(), true) == exp.str());
+
+      // A threshold change is private to the connection.
+      IslaModel small(model);
+      small.setIslandThreshold(1.0E5);
+      small.reclassify();
+      exp.str("");
+      exp << "OK " << small.islands().size() << "\n";
+      assert(transact(fd, "threshold std_mask.nc 1.0E5", false) == exp.str());
+      int fd2 = connectTo(sockfile);
+      assert(fd2 >= 0);
+      exp.str("");
+      exp << "OK " << model.islands().size() << "\n";
+      string resp = transact(fd2, "islands std_mask.nc", true);
+      assert(resp.compare(0, exp.str().size(), exp.str()) == 0);
+      assert(transact(fd2, "quit", false) == "OK\n");
+      close(fd2);
+
+      assert(transact(fd, "list", true) == "OK 1\nstd_mask.nc\n.\n");
+      assert(transact(fd, "frobnicate", false).compare(0, 4, "ERR ") == 0);
+      assert(transact(fd, "islands", false).compare(0, 4, "ERR ") == 0);
+      assert(transact(fd, "unload std_mask.nc", false) == "OK\n");
+      assert(transact(fd, "list", true) == "OK 0\n.\n");
+
+      // A mask saved with derived data is loaded without
+      // recalculation: a corrupted segmentation is served as it is.
+      const char *ncfile = "test_IslaServer.nc";
+      model.saveMask(ncfile, true, false);
+      corruptSegments(ncfile);
+      IslaModel bad(IslaModel::HadCM3L, 8.0E6);
+      bad.loadMask(ncfile, "mask");
+      ostringstream badbody;
+      bad.saveIslands(badbody);
+      assert(badbody.str() != body.str());
+      exp.str("");
+      exp << "OK " << bad.islands().size() << "\n" << badbody.str() << ".\n";
+      assert(transact(fd, "load test_IslaServer.nc", false).
+             compare(0, 3, "OK ") == 0);
+      remove(ncfile);
+      assert(transact(fd, "islands test_IslaServer.nc", true) == exp.str());
+
+      // Shutdown stops the server.
+      assert(transact(fd, "shutdown", false) == "OK\n");
+      close(fd);
+      runner.join();
+    }
+
+    // The socket goes with the server.
+    assert(access(sockfile, F_OK) != 0);
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
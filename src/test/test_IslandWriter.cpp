@@ -0,0 +1,77 @@
+#include <iostream>
+#include <cstdio>
+#include <cassert>
+#include "IslaModel.hh"
+#include "TestFixture.hh"
+
+using namespace std;
+
+int main(void)
+{
+  try {
+    IslaModel model(IslaModel::HadCM3L, 8.0E6);
+    loadTestMask(model);
+    GridPtr gr = model.grid();
+    int nisl = model.islands().size();
+
+    // Write island file and read it back as comparison data.
+    const char *tmpfile = "test_IslandWriter.isl";
+    model.saveIslands(tmpfile);
+    vector<IslaModel::IslandInfo> cmp;
+    bool ok = model.loadIslands(tmpfile, cmp);
+    remove(tmpfile);
+    assert(ok);
+    assert(static_cast<int>(cmp.size()) == nisl);
+    map<LMass, IslaModel::IslandInfo> isles = model.islands();
+    int i = 0;
+    for (map<LMass, IslaModel::IslandInfo>::const_iterator it = isles.begin();
+         it != isles.end(); ++it, ++i)
+      assert(cmp[i].segments == it->second.segments);
+
+    // Binary island files read back the same.
+    model.saveIslands(tmpfile, IslandWriter::BINARY);
+    cmp.clear();
+    ok = model.loadIslands(tmpfile, cmp);
+    remove(tmpfile);
+    assert(ok && static_cast<int>(cmp.size()) == nisl);
+    i = 0;
+    for (map<LMass, IslaModel::IslandInfo>::const_iterator it = isles.begin();
+         it != isles.end(); ++it, ++i) {
+      assert(cmp[i].name == it->second.name);
+      assert(cmp[i].segments == it->second.segments);
+    }
+
+    // Out of range segment bounds are clamped (and reported), names
+    // come from comments, and bad integers are reported with their
+    // line numbers.
+    {
+      const char *tmpfile = "test_IslandWriter.isl";
+      FILE *fp = fopen(tmpfile, "w");
+      assert(fp);
+      fprintf(fp, "# Test\n2\n# First\n1\n1\n4\n 3\t\n9999\n\n"
+              "1\n2\n2\n2\nx3\n");
+      fclose(fp);
+      cmp.clear();
+      string msg;
+      try { model.loadIslands(tmpfile, cmp); }
+      catch (exception &e) { msg = e.what(); }
+      assert(msg.find("line 14") != string::npos);
+      fp = fopen(tmpfile, "w");
+      fprintf(fp, "# Test\n2\n# First\n1\n1\n4\n 3\t\n9999\n\n"
+              "1\n2\n2\n2\n3");
+      fclose(fp);
+      cmp.clear();
+      assert(!model.loadIslands(tmpfile, cmp));
+      remove(tmpfile);
+      assert(cmp.size() == 2 && cmp[0].name == " First");
+      assert(cmp[1].name == "Island 2");
+      assert(cmp[0].segments[0] == Rect(2, 3, 3, gr->nlat() - 2));
+      assert(cmp[1].segments[0] == Rect(2, 2, 1, 2));
+    }
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include "IslaModel.hh"
+#include "Regrid.hh"
+#include "TestFixture.hh"
+
+using namespace std;
+
+int main(void)
+{
+  try {
+    // Regridding only needs the mask itself.
+    GridData<bool> lsm = readTestMask();
+    GridPtr gr = lsm.grid();
+
+    // Regridding: overlap areas cover the sphere, land area is
+    // conserved, regridding to the same grid is exact, weights are
+    // cached by grid coordinates and thread count doesn't matter.
+    {
+      GridPtr coarse(new Grid(37, -90.0, 5.0, 48, 0.0, 7.5));
+      RegridWeights::Ptr w = RegridWeights::get(gr, coarse);
+      GridPtr coarse2(new Grid(*coarse));
+      assert(RegridWeights::get(gr, coarse2) == w);
+      vector<size_t> idx;
+      vector<double> ws;
+      double total = 0.0, srcland = 0.0, dstland = 0.0;
+      RegridWeights::Ptr ident = RegridWeights::get(gr, gr);
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+          if (lsm(r, c)) {
+            ident->cell(r, c, idx, ws);
+            assert(idx.size() == 1 && idx[0] == r * gr->nlon() + c);
+            srcland += ws[0];
+          }
+      GridData<double> frac(coarse, -1.0), frac1(coarse, -1.0);
+      regrid(lsm, frac, LandFraction());
+      regrid(lsm, frac1, LandFraction(), 1);
+      assert(frac.data() == frac1.data());
+      for (int r = 0; r < 37; ++r)
+        for (int c = 0; c < 48; ++c) {
+          w->cell(r, c, idx, ws);
+          double a = 0.0;
+          for (size_t k = 0; k < ws.size(); ++k) a += ws[k];
+          total += a;
+          dstland += frac(r, c) * a;
+          assert(frac(r, c) >= 0.0 && frac(r, c) <= 1.0);
+        }
+      assert(fabs(total / (4 * M_PI * 6370.0 * 6370.0) - 1.0) < 1.0E-9);
+      assert(fabs(dstland / srcland - 1.0) < 1.0E-9);
+      GridData<bool> same(gr, false);
+      regrid(lsm, same, Majority());
+      assert(same.data() == lsm.data());
+      for (int g = IslaModel::HadCM3L; g <= IslaModel::HadGEM2; ++g) {
+        IslaModel::GridType gt = static_cast<IslaModel::GridType>(g);
+        GridData<bool> stdmask(IslaModel::makeGrid(gt), false);
+        regrid(lsm, stdmask, Majority());
+        if (gt == IslaModel::HadCM3) assert(stdmask.data() == lsm.data());
+      }
+      GridData<bool> maj(coarse, false);
+      regrid(frac, maj, Majority(0.5));
+      regrid(lsm, frac1, WeightedMean());
+      assert(frac1.data() == frac.data());
+    }
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
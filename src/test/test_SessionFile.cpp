@@ -0,0 +1,95 @@
+#include <iostream>
+#include <cstdio>
+#include <cassert>
+#include "IslaModel.hh"
+#include "TestFixture.hh"
+#include "SessionFile.hh"
+
+using namespace std;
+
+int main(void)
+{
+  try {
+    IslaModel model(IslaModel::HadCM3L, 8.0E6);
+    loadTestMask(model);
+    GridPtr gr = model.grid();
+    map<LMass, IslaModel::IslandInfo> isles = model.islands();
+    vector<IslaModel::IslandInfo> cmp;
+    for (map<LMass, IslaModel::IslandInfo>::const_iterator it = isles.begin();
+         it != isles.end(); ++it)
+      cmp.push_back(it->second);
+
+    // Session files restore the whole model state and comparison
+    // islands.
+    {
+      const char *sessfile = "test_SessionFile.isls";
+      model.saveSession(sessfile, cmp);
+      assert(SessionFile::isSessionFile(sessfile));
+      assert(!SessionFile::isSessionFile("std_mask.nc"));
+      IslaModel sess(IslaModel::HadGEM2, 1.0);
+      vector<IslaModel::IslandInfo> sesscmp;
+      sess.loadSession(sessfile, sesscmp);
+      remove(sessfile);
+      assert(sess.gridType() == IslaModel::HadCM3L);
+      assert(sess.islandThreshold() == 8.0E6);
+      assert(sess.grid()->lats() == gr->lats());
+      assert(sess.grid()->lons() == gr->lons());
+      assert(sess.landMassCount() == model.landMassCount());
+      for (int r = 0; r < static_cast<int>(gr->nlat()); ++r)
+        for (int c = 0; c < static_cast<int>(gr->nlon()); ++c)
+          assert(sess.maskVal(r, c) == model.maskVal(r, c) &&
+                 sess.origMaskVal(r, c) == model.origMaskVal(r, c) &&
+                 sess.landMass(r, c) == model.landMass(r, c) &&
+                 sess.isMask(r, c) == model.isMask(r, c) &&
+                 sess.isIsland(r, c) == model.isIsland(r, c));
+      assert(sess.landMassBBox().size() == model.landMassBBox().size());
+      map<LMass, IslaModel::IslandInfo> sessisles = sess.islands();
+      assert(sessisles.size() == isles.size());
+      for (map<LMass, IslaModel::IslandInfo>::const_iterator
+             it = isles.begin(), sit = sessisles.begin();
+           it != isles.end(); ++it, ++sit) {
+        assert(sit->first == it->first && sit->second.name == it->second.name);
+        assert(sit->second.segments == it->second.segments);
+        assert(sit->second.minsegs == it->second.minsegs);
+        assert(sit->second.absminsegs == it->second.absminsegs);
+        assert(sit->second.vcoinc == it->second.vcoinc);
+      }
+      assert(sesscmp.size() == cmp.size());
+      for (size_t j = 0; j < cmp.size(); ++j)
+        assert(sesscmp[j].name == cmp[j].name &&
+               sesscmp[j].segments == cmp[j].segments);
+    }
+
+    // A session with a landmass bounding box outside the grid is
+    // rejected and leaves the model untouched.
+    {
+      const char *sessfile = "test_SessionFile.isls";
+      model.saveSession(sessfile, cmp);
+      SessionFile::Header hdr;
+      FILE *fp = fopen(sessfile, "r+b");
+      assert(fp && fread(&hdr, sizeof(hdr), 1, fp) == 1);
+      SessionFile::BBoxRecord rec;
+      fseek(fp, hdr.offset[SessionFile::LMBBOX], SEEK_SET);
+      assert(fread(&rec, sizeof(rec), 1, fp) == 1);
+      rec.b1[3] = gr->nlat() + 1;
+      fseek(fp, hdr.offset[SessionFile::LMBBOX], SEEK_SET);
+      fwrite(&rec, sizeof(rec), 1, fp);
+      fclose(fp);
+      IslaModel sess(IslaModel::HadGEM2, 1.0);
+      vector<IslaModel::IslandInfo> sesscmp;
+      string msg;
+      try { sess.loadSession(sessfile, sesscmp); }
+      catch (exception &e) { msg = e.what(); }
+      remove(sessfile);
+      assert(msg.find("Corrupt session file") != string::npos);
+      assert(sess.gridType() == IslaModel::HadGEM2);
+      assert(sess.islandThreshold() == 1.0);
+      assert(sesscmp.empty());
+    }
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+#include <algorithm>
+#include "IslaModel.hh"
+#include "TestFixture.hh"
+#include "UMFile.hh"
+
+using namespace std;
+
+int main(void)
+{
+  try {
+    IslaModel model(IslaModel::HadCM3L, 8.0E6);
+    loadTestMask(model);
+    GridPtr gr = model.grid();
+    int nisl = model.islands().size();
+    map<LMass, IslaModel::IslandInfo> isles = model.islands();
+    vector<IslaModel::IslandInfo> cmp;
+    bool ok;
+    int i;
+
+    // Write the islands into a minimal 64-bit UM ocean dump, in both
+    // byte orders, and read them back.
+    vector<long long> hdr(256 + 7, -32768);
+    vector<double> extra(1, nisl);
+    for (map<LMass, IslaModel::IslandInfo>::const_iterator it = isles.begin();
+         it != isles.end(); ++it) {
+      const vector<Rect> &segs = it->second.segments;
+      extra.push_back(segs.size());
+      for (int k = 0; k < 4; ++k)
+        for (unsigned int s = 0; s < segs.size(); ++s)
+          extra.push_back(k == 0 ? segs[s].x :
+                          k == 1 ? segs[s].x + segs[s].width - 1 :
+                          k == 2 ? segs[s].y : segs[s].y + segs[s].height - 1);
+    }
+    hdr[1] = 2;  hdr[4] = 1;
+    hdr[99] = 257;  hdr[100] = 7;
+    hdr[129] = 264;  hdr[130] = extra.size();
+    hdr[256 + 5] = gr->nlon() + 2;  hdr[256 + 6] = gr->nlat();
+    for (int swap = 0; swap < 2; ++swap) {
+      const char *dumpfile = "test_UMFile.dump";
+      FILE *fp = fopen(dumpfile, "wb");
+      assert(fp);
+      for (unsigned int w = 0; w < hdr.size() + extra.size(); ++w) {
+        unsigned char b[8];
+        if (w < hdr.size()) memcpy(b, &hdr[w], 8);
+        else memcpy(b, &extra[w - hdr.size()], 8);
+        if (swap) reverse(b, b + 8);
+        fwrite(b, 1, 8, fp);
+      }
+      fclose(fp);
+      cmp.clear();
+      ok = model.loadIslands(dumpfile, cmp);
+      remove(dumpfile);
+      assert(ok && static_cast<int>(cmp.size()) == nisl);
+      i = 0;
+      for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+             isles.begin(); it != isles.end(); ++it, ++i)
+        assert(cmp[i].segments == it->second.segments);
+    }
+
+    // Corrupt segment counts (one that wraps round when multiplied
+    // up in 32 bits, a negative one and a NaN) are rejected.
+    {
+      const char *dumpfile = "test_UMFile.dump";
+      double bad[3] = { 1073741824.0, -1.0, NAN };
+      for (int k = 0; k < 3; ++k) {
+        vector<double> badextra(extra);
+        badextra[1] = bad[k];
+        FILE *fp = fopen(dumpfile, "wb");
+        assert(fp);
+        fwrite(&hdr[0], 8, hdr.size(), fp);
+        fwrite(&badextra[0], 8, badextra.size(), fp);
+        fclose(fp);
+        string msg;
+        cmp.clear();
+        try { model.loadIslands(dumpfile, cmp); }
+        catch (exception &e) { msg = e.what(); }
+        assert(msg.find("Format error") != string::npos);
+      }
+      remove(dumpfile);
+    }
+
+    // Write islands back into a dump with an empty island section
+    // followed by a lookup table and a field: the section grows and
+    // the field moves with it.  A second write fits in place.
+    {
+      const char *dumpfile = "test_UMFile.dump";
+      vector<long long> words(256 + 7 + 1 + 64 + 10, -32768);
+      words[0] = 20;  words[1] = 2;  words[4] = 1;
+      words[99] = 257;  words[100] = 7;
+      words[129] = 264;  words[130] = 1;
+      words[149] = 265;  words[150] = 64;  words[151] = 1;
+      words[159] = 329;
+      words[256 + 5] = gr->nlon() + 2;  words[256 + 6] = gr->nlat();
+      double zero = 0.0;
+      memcpy(&words[263], &zero, 8);
+      words[264 + 28] = 328;
+      for (int k = 0; k < 10; ++k) words[328 + k] = 1000 + k;
+      FILE *fp = fopen(dumpfile, "wb");
+      assert(fp);
+      fwrite(&words[0], 8, words.size(), fp);
+      fclose(fp);
+      for (int pass = 0; pass < 2; ++pass) {
+        model.saveIslandsToDump(dumpfile);
+        cmp.clear();
+        assert(model.loadIslands(dumpfile, cmp));
+        assert(static_cast<int>(cmp.size()) == nisl);
+        i = 0;
+        for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+               isles.begin(); it != isles.end(); ++it, ++i)
+          assert(cmp[i].segments == it->second.segments);
+        UMFile um(dumpfile);
+        long long len = um.fixhd(UMFile::FH_EXTRA_LEN);
+        assert(len >= static_cast<long long>(extra.size()));
+        assert(um.fixhd(UMFile::FH_LOOKUP_START) == 264 + len);
+        size_t start = um.fieldStart(1);
+        assert(static_cast<long long>(start) ==
+               um.fixhd(UMFile::FH_DATA_START));
+        for (int k = 0; k < 10; ++k) assert(um.word(start + k) == 1000 + k);
+      }
+      remove(dumpfile);
+    }
+
+    // Write the mask as a byte-swapped 32-bit UM ancillary file, with
+    // rows running north to south, and read it back.
+    {
+      int nlat = gr->nlat(), nlon = gr->nlon();
+      float dlat = gr->lat(1) - gr->lat(0), dlon = gr->lon(1) - gr->lon(0);
+      vector<int32_t> words(256 + 64 + nlat * nlon, -32768);
+      int32_t *lookup = &words[256];
+      words[1] = 1;  words[4] = 4;
+      words[149] = 257;  words[150] = 64;  words[151] = 1;
+      words[159] = 321;
+      lookup[14] = nlat * nlon;  lookup[17] = nlat;  lookup[18] = nlon;
+      lookup[20] = 0;  lookup[28] = 320;  lookup[38] = 3;  lookup[41] = 30;
+      float bzy = gr->lat(nlat - 1) + dlat, bdy = -dlat;
+      float bzx = gr->lon(0) - dlon, bdx = dlon;
+      memcpy(&lookup[58], &bzy, 4);  memcpy(&lookup[59], &bdy, 4);
+      memcpy(&lookup[60], &bzx, 4);  memcpy(&lookup[61], &bdx, 4);
+      for (int r = 0; r < nlat; ++r)
+        for (int c = 0; c < nlon; ++c)
+          words[320 + (nlat - 1 - r) * nlon + c] = model.maskVal(r, c);
+      const char *ancfile = "test_UMFile.anc";
+      FILE *fp = fopen(ancfile, "wb");
+      assert(fp);
+      for (unsigned int w = 0; w < words.size(); ++w) {
+        unsigned char b[4];
+        memcpy(b, &words[w], 4);
+        reverse(b, b + 4);
+        fwrite(b, 1, 4, fp);
+      }
+      fclose(fp);
+      assert(UMFile::isUMFile(ancfile));
+      GridData<bool> ummask = IslaModel::readUMMask(ancfile);
+      remove(ancfile);
+      assert(ummask.nlat() == nlat && ummask.nlon() == nlon);
+      for (int r = 0; r < nlat; ++r) {
+        assert(fabs(ummask.grid()->lat(r) - gr->lat(r)) < 1.0E-4);
+        for (int c = 0; c < nlon; ++c)
+          assert(ummask(r, c) == model.maskVal(r, c));
+      }
+    }
+
+    // Files that only look like UM files at first glance are
+    // rejected: a classic NetCDF file whose record count passes for
+    // a 32-bit sub-model code, and a UM header whose lookup table
+    // runs past the end of the file.
+    {
+      const char *fakefile = "test_UMFile.fake";
+      vector<unsigned char> nc(8 * 256, 0);
+      memcpy(&nc[0], "CDF\x01\x00\x00\x00\x02", 8);
+      FILE *fp = fopen(fakefile, "wb");
+      assert(fp);
+      fwrite(&nc[0], 1, nc.size(), fp);
+      fclose(fp);
+      assert(!UMFile::isUMFile(fakefile));
+      vector<int32_t> words(256 + 64, -32768);
+      words[1] = 1;  words[4] = 4;
+      words[149] = 257;  words[150] = 64;  words[151] = 2;
+      fp = fopen(fakefile, "wb");
+      assert(fp);
+      fwrite(&words[0], 4, words.size(), fp);
+      fclose(fp);
+      assert(!UMFile::isUMFile(fakefile));
+      words[151] = 1;
+      fp = fopen(fakefile, "wb");
+      assert(fp);
+      fwrite(&words[0], 4, words.size(), fp);
+      fclose(fp);
+      assert(UMFile::isUMFile(fakefile));
+      remove(fakefile);
+    }
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
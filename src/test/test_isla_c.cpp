@@ -0,0 +1,99 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include "IslaModel.hh"
+#include "isla_c.h"
+#include "TestFixture.hh"
+
+using namespace std;
+
+// Do the C interface's gridded results and islands match a model's?
+// The C model was loaded with latitudes reversed.
+
+static bool sameResults(isla_model *cm, IslaModel &model)
+{
+  GridPtr gr = model.grid();
+  int nlat = gr->nlat(), nlon = gr->nlon();
+  if (isla_nlat(cm) != nlat || isla_nlon(cm) != nlon ||
+      isla_landmass_count(cm) != static_cast<int>(model.landMassCount()) ||
+      isla_island_count(cm) != static_cast<int>(model.islands().size()))
+    return false;
+  vector<int> lm(nlat * nlon), ism(nlat * nlon);
+  vector<unsigned char> isl(nlat * nlon);
+  if (isla_get_landmass(cm, &lm[0]) || isla_get_ismask(cm, &ism[0]) ||
+      isla_get_is_island(cm, &isl[0]))
+    return false;
+  for (int r = 0; r < nlat; ++r)
+    for (int c = 0; c < nlon; ++c) {
+      int i = (nlat - 1 - r) * nlon + c;
+      if (lm[i] != static_cast<int>(model.landMass(r, c)) ||
+          ism[i] != model.isMask(r, c) || isl[i] != model.isIsland(r, c))
+        return false;
+    }
+
+  int nisl = isla_island_count(cm), nseg = isla_segment_count(cm);
+  vector<int> nsegs(nisl + 1), isis(nseg + 1), ieis(nseg + 1);
+  vector<int> jsis(nseg + 1), jeis(nseg + 1);
+  if (isla_get_islands(cm, &nsegs[0], &isis[0], &ieis[0], &jsis[0], &jeis[0]))
+    return false;
+  int i = 0, s = 0;
+  for (map<LMass, IslaModel::IslandInfo>::const_iterator it =
+         model.islands().begin(); it != model.islands().end(); ++it, ++i) {
+    const vector<Rect> &segs = it->second.segments;
+    if (nsegs[i] != static_cast<int>(segs.size())) return false;
+    for (unsigned int k = 0; k < segs.size(); ++k, ++s)
+      if (isis[s] != segs[k].x || ieis[s] != segs[k].GetRight() ||
+          jsis[s] != segs[k].y || jeis[s] != segs[k].GetBottom())
+        return false;
+  }
+  return s == nseg;
+}
+
+int main(void)
+{
+  try {
+    IslaModel model(IslaModel::HadCM3L, 8.0E6);
+    loadTestMask(model);
+    GridPtr gr = model.grid();
+    int nlat = gr->nlat(), nlon = gr->nlon();
+
+    // Masks passed north to south, as bytes and as ints.
+    vector<double> lats = gr->lats(), lons = gr->lons();
+    reverse(lats.begin(), lats.end());
+    vector<unsigned char> u8(nlat * nlon);
+    vector<int> i32(nlat * nlon);
+    for (int r = 0; r < nlat; ++r)
+      for (int c = 0; c < nlon; ++c) {
+        int i = (nlat - 1 - r) * nlon + c;
+        u8[i] = model.maskVal(r, c);
+        i32[i] = model.maskVal(r, c) ? -1 : 0;
+      }
+    isla_model *cm = isla_create(8.0E6);
+    assert(cm);
+    assert(isla_load_mask_u8(cm, nlat, nlon, &lats[0], &lons[0],
+                             &u8[0]) == 0);
+    assert(sameResults(cm, model));
+    assert(isla_load_mask_i32(cm, nlat, nlon, &lats[0], &lons[0],
+                              &i32[0]) == 0);
+    assert(sameResults(cm, model));
+
+    // Bad arguments are reported as errors.
+    assert(isla_load_mask_u8(cm, 1, nlon, &lats[0], &lons[0],
+                             &u8[0]) == -1);
+    assert(string(isla_last_error(cm)) != "");
+    assert(isla_get_landmass(cm, 0) == -1);
+    assert(isla_get_islands(cm, 0, 0, 0, 0, 0) == -1);
+
+    // With no islands, no island or segment buffers are needed.
+    assert(isla_set_threshold(cm, 1.0E-3) == 0);
+    assert(isla_island_count(cm) == 0 && isla_segment_count(cm) == 0);
+    assert(isla_get_islands(cm, 0, 0, 0, 0, 0) == 0);
+    isla_destroy(cm);
+  } catch (exception &e) {
+    cout << "EXCEPTION: " << e.what() << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}